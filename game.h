@@ -4,16 +4,31 @@
 #include <stdint.h>
 #include <libretro.h>
 
+#include "game_rng.h"
+
 #define FONT "cairo:monospace"
 #define FONT_SIZE 20
 #define SPACING    (int)(FONT_SIZE * 0.4)
 #define TILE_SIZE (FONT_SIZE * 4)
 #define TILE_ANIM_SPEED 5
 
-#define GRID_WIDTH   4
-#define GRID_HEIGHT  4
+/* board size, picked at build time with GRID=N */
+#ifndef GRID_DIM
+#define GRID_DIM     4
+#endif
+
+#if GRID_DIM < 3 || GRID_DIM > 8
+#error "GRID_DIM must be between 3 and 8"
+#endif
+
+#define GRID_WIDTH   GRID_DIM
+#define GRID_HEIGHT  GRID_DIM
 #define GRID_SIZE    (GRID_WIDTH * GRID_HEIGHT)
 
+/* largest tile exponent with a label and colour in the renderers, and
+ * where merging stops on byte-cell boards */
+#define MAX_TILE_EXPONENT 31
+
 #define BOARD_WIDTH  (SPACING + TILE_SIZE * GRID_WIDTH  + SPACING * (GRID_WIDTH  - 1) + SPACING)
 #define BOARD_HEIGHT (SPACING + TILE_SIZE * GRID_HEIGHT + SPACING * (GRID_HEIGHT - 1) + SPACING)
 
@@ -22,6 +37,13 @@
 #define SCREEN_WIDTH   SPACING + BOARD_WIDTH + SPACING
 #define SCREEN_HEIGHT  BOARD_OFFSET_Y + BOARD_HEIGHT + SPACING
 
+/* score and best panels share the width above the board */
+#define PANEL_WIDTH    ((BOARD_WIDTH - SPACING) / 2)
+#define BEST_OFFSET_X  (SPACING * 2 + PANEL_WIDTH)
+
+/* top of the message boxes on the title and overlay screens */
+#define MESSAGE_OFFSET_Y  (TILE_SIZE * GRID_HEIGHT)
+
 extern int SCREEN_PITCH;
 extern bool dark_theme;
 
@@ -33,6 +55,8 @@ typedef struct
    int right;
    int start;
    int select;
+   int undo;
+   int hint;
 } key_state_t;
 
 typedef enum
@@ -59,23 +83,48 @@ typedef struct vector
    int y;
 } vector_t;
 
-typedef struct cell {
-   int value;
-   vector_t pos;
-   vector_t old_pos;
-   float move_time;
-   float appear_time;
-   struct cell *source;
-} cell_t;
+/* packed tile exponents, see game_board.h */
+#if GRID_WIDTH <= 4
+#define BOARD_CELL_BITS 4
+typedef struct
+{
+   uint64_t lo;
+   uint64_t hi;
+} board_t;
+#else
+#define BOARD_CELL_BITS 8
+typedef struct
+{
+   uint64_t row[GRID_HEIGHT];
+} board_t;
+#endif
+
+/* moves that can be taken back */
+#define UNDO_DEPTH 16
+
+/* the rules state before one move, the animation is not kept */
+typedef struct
+{
+   board_t board;
+   rng_t rng;
+   int64_t score;
+} undo_entry_t;
 
 typedef struct game {
-   int score;
-   int best_score;
+   int64_t score;
+   int64_t best_score;
    bool won_before;
    game_state_t state;
    key_state_t old_ks;
    direction_t direction;
-   cell_t grid[GRID_SIZE];
+   board_t board;
+   uint64_t empty_cells;
+   bool moves_available;
+   rng_t rng;
+   /* ring buffer, undo_head is the next slot to write */
+   undo_entry_t undo[UNDO_DEPTH];
+   unsigned undo_head;
+   unsigned undo_count;
 } game_t;
 
 extern retro_environment_t environ_cb;
@@ -91,9 +140,36 @@ void game_update(float delta, key_state_t *new_ks);
 void *game_data(void);
 void *game_save_data(void);
 unsigned game_data_size(void);
+/* Replaces the game with save data after checking it, false when it is
+ * unusable and the game was left alone. */
+bool game_load_data(const void *data);
+/* Checks save data written straight into game_data(), falling back to
+ * a new game on the title screen when it is unusable. */
+bool game_check_data(void);
 void game_render(void);
 int game_init_pixelformat(void);
 
+void game_set_clock(retro_perf_get_time_usec_t get_time_usec);
+void game_set_frame_budget(retro_time_t usec);
+void game_set_autoplay(bool enabled);
+void game_set_ai_memory(size_t bytes);
+/* n-tuple weights for the AI, NULL for the built-in heuristic */
+bool game_set_ai_weights(const char *path);
+/* endgame tablebase for the AI, NULL for none */
+bool game_set_ai_tablebase(const char *path);
+void game_set_seed(bool fixed, uint64_t seed);
+
+/* Receives the replay stream (see game_replay.h) without its header,
+ * NULL stops recording. */
+typedef void (*game_replay_sink_t)(const void *data, size_t size);
+void game_set_replay_sink(game_replay_sink_t sink);
+/* Marks the stream where a save state was taken. */
+void game_replay_mark(void);
+/* Records the board after a save state or save file replaced it. What
+ * was recorded since the last mark is dropped first, and nothing is
+ * recorded when the game is the one at the mark. */
+void game_replay_sync(void);
+
 void render_playing(void);
 void render_title(void);
 void render_win_or_game_over(void);
@@ -0,0 +1,464 @@
+#include <stdint.h>
+#include <math.h>
+
+#include "game_ai.h"
+#include "game_tt.h"
+#include "game_pool.h"
+#include "game_ntuple.h"
+#include "game_tb.h"
+
+/* heuristic weights */
+#define SCORE_LOST_PENALTY        200000.0f
+#define SCORE_MONOTONICITY_POWER  4.0f
+#define SCORE_MONOTONICITY_WEIGHT 47.0f
+#define SCORE_SUM_POWER           3.5f
+#define SCORE_SUM_WEIGHT          11.0f
+#define SCORE_MERGES_WEIGHT       700.0f
+#define SCORE_EMPTY_WEIGHT        270.0f
+
+/* evaluations between two clock reads */
+#define CLOCK_CHECK_MASK 1023
+
+/* shallower searches are not worth handing to the pool */
+#define AI_PARALLEL_DEPTH 3
+
+typedef struct
+{
+   retro_time_t deadline;
+   unsigned evals;
+   volatile int *aborted;
+   /* set by the caller to give up, polled with the clock */
+   const volatile int *cancel;
+} ai_search_t;
+
+/* One child of a root chance node, searched on the pool. Results are
+ * combined in a fixed order afterwards, so the outcome does not depend
+ * on the number of threads or on scheduling. */
+typedef struct
+{
+   board_t board;
+   int depth;
+   float value;
+   const ai_search_t *search;
+} ai_task_t;
+
+#if BOARD_CELL_BITS == 4
+static float row_heur_table[BOARD_ROW_COUNT];
+#endif
+static float sum_pow[BOARD_MAX_EXPONENT + 1];
+static float mono_pow[BOARD_MAX_EXPONENT + 1];
+static bool ai_ready = false;
+/* Value of a board with no move left. Every line of it scores as low
+ * as the heuristic can go, so it ranks below any board still in play.
+ * The n-tuple nets are trained towards 0 at the end of a game. */
+static float lost_value;
+static retro_perf_get_time_usec_t ai_clock = NULL;
+static size_t ai_memory = AI_DEFAULT_MEMORY;
+static bool ai_memory_dirty = true;
+
+/* trained evaluator, replaces the heuristic while loaded */
+static ntuple_t ai_net;
+static bool ai_net_loaded = false;
+
+/* exact play where it covers the board, ahead of any search */
+static tb_t ai_tb;
+
+static float line_heuristic(const int *line, int n)
+{
+   int i;
+   int empty = 0, merges = 0, prev = 0, counter = 0;
+   float sum = 0, mono_left = 0, mono_right = 0;
+
+   for (i = 0; i < n; i++)
+   {
+      int rank = line[i];
+
+      sum += sum_pow[rank];
+
+      if (!rank)
+         empty++;
+      else
+      {
+         if (prev == rank)
+            counter++;
+         else if (counter > 0)
+         {
+            merges += 1 + counter;
+            counter = 0;
+         }
+         prev = rank;
+      }
+   }
+
+   if (counter > 0)
+      merges += 1 + counter;
+
+   for (i = 1; i < n; i++)
+   {
+      float a = mono_pow[line[i - 1]];
+      float b = mono_pow[line[i]];
+
+      if (line[i - 1] > line[i])
+         mono_left  += a - b;
+      else
+         mono_right += b - a;
+   }
+
+   return SCORE_LOST_PENALTY +
+          SCORE_EMPTY_WEIGHT  * empty +
+          SCORE_MERGES_WEIGHT * merges -
+          SCORE_MONOTONICITY_WEIGHT * (mono_left < mono_right ? mono_left : mono_right) -
+          SCORE_SUM_WEIGHT * sum;
+}
+
+void ai_init(void)
+{
+   int i;
+
+   if (ai_memory_dirty)
+   {
+      tt_init(ai_memory);
+      ai_memory_dirty = false;
+   }
+
+   if (ai_ready)
+      return;
+
+   board_init_tables();
+
+   for (i = 0; i <= BOARD_MAX_EXPONENT; i++)
+   {
+      sum_pow[i]  = powf(i, SCORE_SUM_POWER);
+      mono_pow[i] = powf(i, SCORE_MONOTONICITY_POWER);
+   }
+
+   lost_value = 2 * GRID_HEIGHT * (SCORE_LOST_PENALTY -
+         SCORE_MONOTONICITY_WEIGHT * (GRID_WIDTH - 1) * mono_pow[BOARD_MAX_EXPONENT] -
+         SCORE_SUM_WEIGHT * GRID_WIDTH * sum_pow[BOARD_MAX_EXPONENT]);
+
+#if BOARD_CELL_BITS == 4
+   for (i = 0; i < BOARD_ROW_COUNT; i++)
+   {
+      int j, line[GRID_WIDTH];
+
+      for (j = 0; j < GRID_WIDTH; j++)
+         line[j] = (i >> (j << 2)) & 0xf;
+
+      row_heur_table[i] = line_heuristic(line, GRID_WIDTH);
+   }
+#endif
+
+   ai_ready = true;
+}
+
+void ai_deinit(void)
+{
+   tt_deinit();
+   ai_memory_dirty = true;
+
+   ntuple_free(&ai_net);
+   ai_net_loaded = false;
+
+   tb_free(&ai_tb);
+}
+
+void ai_set_memory(size_t bytes)
+{
+   if (bytes == ai_memory)
+      return;
+
+   ai_memory       = bytes;
+   ai_memory_dirty = true;
+}
+
+bool ai_load_weights(const char *path)
+{
+   ntuple_free(&ai_net);
+   ai_net_loaded = path && ntuple_load(&ai_net, path);
+
+   /* cached values came from the other evaluator */
+   ai_memory_dirty = true;
+
+   return ai_net_loaded;
+}
+
+bool ai_load_tablebase(const char *path)
+{
+   tb_free(&ai_tb);
+   return path && tb_load(&ai_tb, path);
+}
+
+void ai_set_clock(retro_perf_get_time_usec_t get_time_usec)
+{
+   ai_clock = get_time_usec;
+}
+
+float ai_evaluate(board_t b)
+{
+   int i, j;
+   float h = 0;
+
+   if (ai_net_loaded)
+      return ntuple_evaluate(&ai_net, b);
+
+#if BOARD_CELL_BITS == 4
+   /* the table covers nibble tiles, fifth bits go cell by cell */
+   if (!b.hi)
+   {
+      uint64_t t = b.lo;
+
+      for (i = 0; i < GRID_HEIGHT; i++)
+      {
+         unsigned row = 0, col = 0;
+
+         for (j = 0; j < GRID_WIDTH; j++)
+         {
+            row |= (unsigned)((t >> ((i * GRID_WIDTH + j) << 2)) & 0xf) << (j << 2);
+            col |= (unsigned)((t >> ((j * GRID_WIDTH + i) << 2)) & 0xf) << (j << 2);
+         }
+
+         h += row_heur_table[row] + row_heur_table[col];
+      }
+
+      return h;
+   }
+#endif
+
+   /* rows too wide for a table are scored cell by cell */
+   for (i = 0; i < GRID_HEIGHT; i++)
+   {
+      int row[GRID_WIDTH], col[GRID_WIDTH];
+
+      for (j = 0; j < GRID_WIDTH; j++)
+      {
+         row[j] = board_get(b, i * GRID_WIDTH + j);
+         col[j] = board_get(b, j * GRID_WIDTH + i);
+      }
+
+      h += line_heuristic(row, GRID_WIDTH) + line_heuristic(col, GRID_WIDTH);
+   }
+
+   return h;
+}
+
+static float search_max(ai_search_t *s, board_t b, int depth);
+
+static float search_chance(ai_search_t *s, board_t b, int depth)
+{
+   int i, n = 0;
+   float sum = 0, value;
+   uint64_t empty, hash = 0;
+
+   if (depth <= 0)
+   {
+      if (!(++s->evals & CLOCK_CHECK_MASK) &&
+          (*s->cancel || (s->deadline && ai_clock() > s->deadline)))
+         *s->aborted = 1;
+
+      return ai_evaluate(b);
+   }
+
+   if (tt_enabled())
+   {
+      hash = tt_hash(b);
+
+      if (tt_probe(hash, depth, &value))
+         return value;
+   }
+
+   for (empty = board_empty_mask(b); empty && !*s->aborted; empty &= empty - 1)
+   {
+      board_t child = b;
+
+      i = board_mask_lowest(empty);
+
+      board_set(child, i, 1);
+      sum += 0.9f * search_max(s, child, depth - 1);
+      board_set(child, i, 2);
+      sum += 0.1f * search_max(s, child, depth - 1);
+      n++;
+   }
+
+   value = n ? sum / n : 0;
+
+   /* an aborted subtree is incomplete, keep it out of the table */
+   if (hash && !*s->aborted)
+      tt_store(hash, depth, value);
+
+   return value;
+}
+
+static float search_max(ai_search_t *s, board_t b, int depth)
+{
+   int dir;
+   float best = 0;
+   bool found = false;
+
+   for (dir = DIR_UP; dir <= DIR_LEFT && !*s->aborted; dir++)
+   {
+      float v;
+      board_t moved = board_move(b, (direction_t)dir, NULL);
+
+      if (board_equal(moved, b))
+         continue;
+
+      v = search_chance(s, moved, depth);
+
+      if (!found || v > best)
+      {
+         best  = v;
+         found = true;
+      }
+   }
+
+   if (!found)
+      return ai_net_loaded ? 0 : lost_value;
+
+   return best;
+}
+
+static void ai_task_run(void *data)
+{
+   ai_task_t *task = (ai_task_t *)data;
+   ai_search_t s   = *task->search;
+
+   s.evals     = 0;
+   task->value = search_max(&s, task->board, task->depth);
+}
+
+static direction_t search_root(ai_search_t *s, board_t b, int depth)
+{
+   int dir, i;
+   int count = 0, first[DIR_LEFT + 1];
+   board_t moved[DIR_LEFT + 1];
+   ai_task_t tasks[4 * GRID_SIZE * 2];
+   float best = 0;
+   direction_t best_dir = DIR_NONE;
+
+   /* children of the four root chance nodes */
+   for (dir = DIR_UP; dir <= DIR_LEFT; dir++)
+   {
+      moved[dir] = board_move(b, (direction_t)dir, NULL);
+      first[dir] = count;
+
+      if (board_equal(moved[dir], b) || depth < 2)
+         continue;
+
+      for (i = 0; i < GRID_SIZE; i++)
+      {
+         if (board_get(moved[dir], i))
+            continue;
+
+         tasks[count].board = moved[dir];
+         board_set(tasks[count].board, i, 1);
+         tasks[count].depth = depth - 2;
+         tasks[count].search = s;
+         count++;
+
+         tasks[count].board = moved[dir];
+         board_set(tasks[count].board, i, 2);
+         tasks[count].depth = depth - 2;
+         tasks[count].search = s;
+         count++;
+      }
+   }
+
+   if (depth >= AI_PARALLEL_DEPTH)
+      pool_run(ai_task_run, tasks, sizeof(*tasks), count);
+   else
+      for (i = 0; i < count; i++)
+         ai_task_run(&tasks[i]);
+
+   if (*s->aborted)
+      return DIR_NONE;
+
+   for (dir = DIR_UP; dir <= DIR_LEFT; dir++)
+   {
+      float v;
+
+      if (board_equal(moved[dir], b))
+         continue;
+
+      if (depth < 2)
+         v = search_chance(s, moved[dir], 0);
+      else
+      {
+         int last = dir < DIR_LEFT ? first[dir + 1] : count;
+         float sum = 0;
+
+         /* same order of operations as search_chance() */
+         for (i = first[dir]; i < last; i += 2)
+         {
+            sum += 0.9f * tasks[i].value;
+            sum += 0.1f * tasks[i + 1].value;
+         }
+
+         v = sum / ((last - first[dir]) / 2);
+      }
+
+      if (best_dir == DIR_NONE || v > best)
+      {
+         best     = v;
+         best_dir = (direction_t)dir;
+      }
+   }
+
+   return best_dir;
+}
+
+direction_t ai_best_move_cancellable(board_t b, int max_depth,
+      retro_time_t budget_usec, const volatile int *cancel)
+{
+   int depth;
+   ai_search_t s;
+   direction_t best;
+   volatile int aborted = 0;
+
+   ai_init();
+
+   if ((best = tb_best_move(&ai_tb, b)) != DIR_NONE)
+      return best;
+
+   tt_new_search();
+
+   s.deadline = 0;
+   s.evals    = 0;
+   s.aborted  = &aborted;
+   s.cancel   = cancel;
+
+   if (max_depth < 1)
+      max_depth = 1;
+   else if (max_depth > AI_MAX_DEPTH)
+      max_depth = AI_MAX_DEPTH;
+
+   if (budget_usec <= 0)
+      return search_root(&s, b, max_depth);
+
+   /* a single ply is always affordable, deeper searches only if
+    * there is a clock to stop them */
+   best = search_root(&s, b, 1);
+
+   if (!ai_clock)
+      return best;
+
+   s.deadline = ai_clock() + budget_usec;
+
+   for (depth = 2; depth <= max_depth && ai_clock() < s.deadline && !*cancel; depth++)
+   {
+      direction_t dir = search_root(&s, b, depth);
+
+      if (aborted)
+         break;
+
+      best = dir;
+   }
+
+   return best;
+}
+
+direction_t ai_best_move(board_t b, int max_depth, retro_time_t budget_usec)
+{
+   static const volatile int never = 0;
+
+   return ai_best_move_cancellable(b, max_depth, budget_usec, &never);
+}
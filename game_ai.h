@@ -0,0 +1,48 @@
+#ifndef _GAME_AI_H
+#define _GAME_AI_H
+
+#include <stdint.h>
+#include <boolean.h>
+
+#include "game.h"
+#include "game_board.h"
+
+#define AI_MAX_DEPTH 8
+#define AI_DEFAULT_MEMORY (16 << 20)
+
+/* Builds the tables and the transposition table. Searches call it on
+ * their own, but threads sharing the AI must have it done up front. */
+void ai_init(void);
+void ai_deinit(void);
+
+/* Transposition table size, allocated on the next search. */
+void ai_set_memory(size_t bytes);
+
+/* Evaluates with the n-tuple weights in 'path' (see game_ntuple.h)
+ * instead of the heuristic. NULL, or a file that does not load, goes
+ * back to the heuristic. */
+bool ai_load_weights(const char *path);
+
+/* Plays from the tablebase in 'path' (see game_tb.h) wherever it covers
+ * the board and can still reach its goal, searching elsewhere. NULL
+ * drops it. */
+bool ai_load_tablebase(const char *path);
+
+/* Clock used to honour search budgets, NULL disables timed search. */
+void ai_set_clock(retro_perf_get_time_usec_t get_time_usec);
+
+/* Value of a position, higher is better. */
+float ai_evaluate(board_t b);
+
+/* Expectimax search for the best direction, DIR_NONE if the board is
+ * stuck. With budget_usec > 0 the search deepens iteratively up to
+ * max_depth and returns the result of the deepest iteration that
+ * completed in time; otherwise max_depth is searched outright. */
+direction_t ai_best_move(board_t b, int max_depth, retro_time_t budget_usec);
+
+/* Same, but gives up soon after another thread sets *cancel. The
+ * result of a cancelled search is not meaningful. */
+direction_t ai_best_move_cancellable(board_t b, int max_depth,
+      retro_time_t budget_usec, const volatile int *cancel);
+
+#endif
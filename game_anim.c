@@ -0,0 +1,144 @@
+#include "game_anim.h"
+
+static cell_t grid[GRID_SIZE];
+
+/* tiles that slid under a merged tile, drawn during the first half
+ * of its move animation */
+static cell_t merge_source[GRID_SIZE];
+
+/* the board the track ends on */
+static board_t shown;
+
+static int64_t delta_score;
+static float delta_score_time = 1;
+
+void anim_reset(board_t b)
+{
+   int i;
+
+   for (i = 0; i < GRID_SIZE; i++)
+   {
+      cell_t *cell = &grid[i];
+
+      cell->pos.x       = i % GRID_WIDTH;
+      cell->pos.y       = i / GRID_WIDTH;
+      cell->old_pos     = cell->pos;
+      cell->move_time   = 1;
+      cell->appear_time = 1;
+      cell->value       = board_get(b, i);
+      cell->source      = NULL;
+   }
+
+   shown            = b;
+   delta_score      = 0;
+   delta_score_time = 1;
+}
+
+void anim_move(board_t from, board_t to, direction_t dir, int64_t score)
+{
+   int i;
+   int src[GRID_SIZE], merged[GRID_SIZE];
+
+   /* derive the animation from the board diff */
+   board_trace(from, to, dir, src, merged);
+
+   for (i = 0; i < GRID_SIZE; i++)
+   {
+      cell_t *cell = &grid[i];
+
+      cell->value = board_get(to, i);
+      cell->old_pos = cell->pos;
+      cell->source = NULL;
+      cell->move_time = 1;
+      cell->appear_time = 1;
+
+      if (!cell->value || src[i] < 0)
+         continue;
+
+      if (merged[i] >= 0)
+      {
+         cell_t *under = &merge_source[i];
+
+         under->value = cell->value - 1;
+         under->pos = cell->pos;
+         under->old_pos = grid[src[i]].pos;
+         under->move_time = src[i] == i ? 1 : 0;
+         under->appear_time = 1;
+         under->source = NULL;
+
+         cell->source = under;
+         cell->old_pos = grid[merged[i]].pos;
+         cell->move_time = 0;
+      }
+      else if (src[i] != i)
+      {
+         cell->old_pos = grid[src[i]].pos;
+         cell->move_time = 0;
+      }
+   }
+
+   shown            = to;
+   delta_score      = score;
+   delta_score_time = score == 0 ? 1 : 0;
+}
+
+void anim_spawn(int i, int value)
+{
+   cell_t *cell = &grid[i];
+
+   cell->old_pos = cell->pos;
+   cell->source = NULL;
+   cell->move_time = 1;
+   cell->appear_time = 0;
+   cell->value = value;
+
+   board_set(shown, i, value);
+}
+
+void anim_sync(board_t b)
+{
+   if (!board_equal(shown, b))
+      anim_reset(b);
+}
+
+void anim_advance(float delta)
+{
+   int i;
+
+   for (i = 0; i < GRID_SIZE; i++)
+   {
+      cell_t *cell = &grid[i];
+
+      if (!cell->value)
+         continue;
+
+      if (cell->move_time < 1)
+      {
+         /* the tile underneath is only drawn for the first half */
+         if (cell->source && cell->move_time < 0.5)
+            cell->source->move_time += delta * TILE_ANIM_SPEED;
+
+         cell->move_time += delta * TILE_ANIM_SPEED;
+      }
+      else if (cell->appear_time < 1)
+         cell->appear_time += delta * TILE_ANIM_SPEED;
+   }
+
+   if (delta_score_time < 1)
+      delta_score_time += delta;
+}
+
+const cell_t *anim_cells(void)
+{
+   return grid;
+}
+
+int64_t anim_delta_score(void)
+{
+   return delta_score;
+}
+
+float anim_delta_score_time(void)
+{
+   return delta_score_time;
+}
@@ -0,0 +1,41 @@
+#ifndef _GAME_ANIM_H
+#define _GAME_ANIM_H
+
+#include "game.h"
+#include "game_board.h"
+
+/* Animation track of the board on screen. The rules code reports what
+ * happened to the board; the track turns that into tile slides, merges
+ * and pop-ins. It belongs to the renderers, which read it while drawing
+ * and advance its clock once per frame, so no game state is touched by
+ * drawing and game_t stays plain rules data. */
+
+typedef struct cell {
+   int value;
+   vector_t pos;
+   vector_t old_pos;
+   float move_time;
+   float appear_time;
+   struct cell *source;
+} cell_t;
+
+/* Shows 'b' at rest, without any animation. */
+void anim_reset(board_t b);
+/* Slides and merges the tiles of 'from' into 'to', 'score' rises
+ * from the score panel. */
+void anim_move(board_t from, board_t to, direction_t dir, int64_t score);
+/* Pops in a new tile. */
+void anim_spawn(int cell, int value);
+
+/* Starts over from 'b' unless the track already ends there, e.g.
+ * after a save state was loaded. */
+void anim_sync(board_t b);
+void anim_advance(float delta);
+
+/* GRID_SIZE cells, row-major */
+const cell_t *anim_cells(void);
+int64_t anim_delta_score(void);
+/* from 0 when the score rises, 1 when done */
+float anim_delta_score_time(void);
+
+#endif
@@ -0,0 +1,781 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "game_board.h"
+
+/* 8-lane byte vectors for the byte-cell boards, see slide_columns() */
+#if BOARD_CELL_BITS == 8 && !defined(BOARD_NO_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BOARD_SIMD
+typedef __m128i lane_t;
+#define lane_load(p)       _mm_loadl_epi64((const __m128i *)(p))
+#define lane_store(p, v)   _mm_storel_epi64((__m128i *)(p), v)
+#define lane_set1(x)       _mm_set1_epi8(x)
+#define lane_eq(a, b)      _mm_cmpeq_epi8(a, b)
+#define lane_and(a, b)     _mm_and_si128(a, b)
+#define lane_andnot(m, a)  _mm_andnot_si128(m, a)
+#define lane_or(a, b)      _mm_or_si128(a, b)
+#define lane_sub(a, b)     _mm_sub_epi8(a, b)
+#define lane_any(v)        (_mm_movemask_epi8(v) != 0)
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define BOARD_SIMD
+typedef uint8x8_t lane_t;
+#define lane_load(p)       vld1_u8((const uint8_t *)(p))
+#define lane_store(p, v)   vst1_u8((uint8_t *)(p), v)
+#define lane_set1(x)       vdup_n_u8(x)
+#define lane_eq(a, b)      vceq_u8(a, b)
+#define lane_and(a, b)     vand_u8(a, b)
+#define lane_andnot(m, a)  vbic_u8(a, m)
+#define lane_or(a, b)      vorr_u8(a, b)
+#define lane_sub(a, b)     vsub_u8(a, b)
+#define lane_any(v)        (vget_lane_u64(vreinterpret_u64_u8(v), 0) != 0)
+#endif
+#endif
+
+#if BOARD_CELL_BITS == 4
+static uint16_t row_left_table[BOARD_ROW_COUNT];
+static uint16_t row_right_table[BOARD_ROW_COUNT];
+static uint32_t row_score_table[BOARD_ROW_COUNT];
+static uint8_t row_empty_table[BOARD_ROW_COUNT];
+/* the row changes when slid left or right */
+static uint8_t row_moves_table[BOARD_ROW_COUNT];
+static bool tables_ready = false;
+#endif
+
+/* Slides one line of tile exponents towards index 0, merging each
+ * pair of equal neighbours at most once. dest[j] receives the index
+ * the tile at j ended up in, or -1 for an empty cell. */
+static int64_t slide_line(const int *in, int *out, int *dest, int n)
+{
+   int j, k = 0;
+   int64_t score = 0;
+   bool merged = false;
+
+   for (j = 0; j < n; j++)
+      out[j] = 0;
+
+   for (j = 0; j < n; j++)
+   {
+      int v = in[j];
+
+      dest[j] = -1;
+
+      if (!v)
+         continue;
+
+      if (k > 0 && !merged && out[k - 1] == v && v < BOARD_MAX_EXPONENT)
+      {
+         out[k - 1] = v + 1;
+         score     += (int64_t)2 << (v + 1);
+         dest[j]    = k - 1;
+         merged     = true;
+      }
+      else
+      {
+         out[k]  = v;
+         dest[j] = k++;
+         merged  = false;
+      }
+   }
+
+   return score;
+}
+
+/* j-th cell of line l, counted from the wall 'dir' slides towards */
+static int line_cell(direction_t dir, int l, int j)
+{
+   switch (dir)
+   {
+      case DIR_LEFT:
+         return l * GRID_WIDTH + j;
+      case DIR_RIGHT:
+         return l * GRID_WIDTH + (GRID_WIDTH - 1 - j);
+      case DIR_UP:
+         return j * GRID_WIDTH + l;
+      case DIR_DOWN:
+      default:
+         return (GRID_HEIGHT - 1 - j) * GRID_WIDTH + l;
+   }
+}
+
+#if BOARD_CELL_BITS == 4
+
+void board_init_tables(void)
+{
+   int row, j;
+
+   if (tables_ready)
+      return;
+
+   /* rows with two 2^15 tiles get junk entries, board_narrow() keeps
+    * them away from the tables */
+   for (row = 0; row < BOARD_ROW_COUNT; row++)
+   {
+      int in[GRID_WIDTH], out[GRID_WIDTH], dest[GRID_WIDTH];
+      unsigned left = 0, right = 0;
+
+      for (j = 0; j < GRID_WIDTH; j++)
+         in[j] = (row >> (j << 2)) & 0xf;
+
+      row_score_table[row] = (uint32_t)slide_line(in, out, dest, GRID_WIDTH);
+
+      for (j = 0; j < GRID_WIDTH; j++)
+         left |= (unsigned)(out[j] & 0xf) << (j << 2);
+
+      /* right is left on the mirrored row */
+      for (j = 0; j < GRID_WIDTH; j++)
+         in[j] = (row >> ((GRID_WIDTH - 1 - j) << 2)) & 0xf;
+
+      slide_line(in, out, dest, GRID_WIDTH);
+
+      for (j = 0; j < GRID_WIDTH; j++)
+         right |= (unsigned)(out[j] & 0xf) << ((GRID_WIDTH - 1 - j) << 2);
+
+      row_left_table[row]  = (uint16_t)left;
+      row_right_table[row] = (uint16_t)right;
+      row_moves_table[row] = left != (unsigned)row || right != (unsigned)row;
+
+      row_empty_table[row] = 0;
+      for (j = 0; j < GRID_WIDTH; j++)
+         if (!((row >> (j << 2)) & 0xf))
+            row_empty_table[row] |= 1 << j;
+   }
+
+   tables_ready = true;
+}
+
+/* The row tables are exact while no tile has a fifth bit and no
+ * merge can make one, that is with at most one 2^15 tile. */
+static bool board_narrow(board_t b)
+{
+   uint64_t t;
+
+   if (b.hi)
+      return false;
+
+   /* bit 4i is set for every nibble i that is 0xf */
+   t  = b.lo & (b.lo >> 2);
+   t &= t >> 1;
+   t &= 0x1111111111111111ULL;
+
+   return !(t & (t - 1));
+}
+
+#if GRID_WIDTH == 4
+static uint64_t nibble_transpose(uint64_t b)
+{
+   uint64_t a1 = b & 0xF0F00F0FF0F00F0FULL;
+   uint64_t a2 = b & 0x0000F0F00000F0F0ULL;
+   uint64_t a3 = b & 0x0F0F00000F0F0000ULL;
+   uint64_t a  = a1 | (a2 << 12) | (a3 >> 12);
+   uint64_t b1 = a & 0xFF00FF0000FF00FFULL;
+   uint64_t b2 = a & 0x00FF00FF00000000ULL;
+   uint64_t b3 = a & 0x00000000FF00FF00ULL;
+
+   return b1 | (b2 >> 24) | (b3 << 24);
+}
+#else
+/* 3x3: the diagonal stays, cells 1/3, 5/7 and 2/6 swap */
+static uint64_t nibble_transpose(uint64_t b)
+{
+   return (b & 0xF000F000FULL) |
+          ((b & 0x000F000F0ULL) << 8) | ((b & 0x0F000F000ULL) >> 8) |
+          ((b & 0x000000F00ULL) << 16) | ((b & 0x00F000000ULL) >> 16);
+}
+#endif
+
+static uint64_t move_rows(uint64_t b, const uint16_t *table, int64_t *score)
+{
+   int r;
+   uint64_t res = 0;
+
+   for (r = 0; r < GRID_HEIGHT; r++)
+   {
+      unsigned row = (unsigned)(b >> (r * BOARD_ROW_BITS)) & BOARD_ROW_MASK;
+
+      res    |= (uint64_t)table[row] << (r * BOARD_ROW_BITS);
+      *score += row_score_table[row];
+   }
+
+   return res;
+}
+
+/* slow path for boards past the tables, one line at a time */
+static board_t move_cells(board_t b, direction_t dir, int64_t *score)
+{
+   int l, j;
+
+   for (l = 0; l < GRID_WIDTH; l++)
+   {
+      int in[GRID_WIDTH], out[GRID_WIDTH], dest[GRID_WIDTH];
+
+      for (j = 0; j < GRID_WIDTH; j++)
+         in[j] = board_get(b, line_cell(dir, l, j));
+
+      *score += slide_line(in, out, dest, GRID_WIDTH);
+
+      for (j = 0; j < GRID_WIDTH; j++)
+         board_set(b, line_cell(dir, l, j), out[j]);
+   }
+
+   return b;
+}
+
+board_t board_move(board_t b, direction_t dir, int64_t *score)
+{
+   int64_t dummy = 0;
+
+   if (!score)
+      score = &dummy;
+
+   if (dir < DIR_UP || dir > DIR_LEFT)
+      return b;
+
+   if (!board_narrow(b))
+      return move_cells(b, dir, score);
+
+   switch (dir)
+   {
+      case DIR_LEFT:
+         b.lo = move_rows(b.lo, row_left_table, score);
+         break;
+      case DIR_RIGHT:
+         b.lo = move_rows(b.lo, row_right_table, score);
+         break;
+      case DIR_UP:
+         b.lo = nibble_transpose(move_rows(nibble_transpose(b.lo), row_left_table, score));
+         break;
+      case DIR_DOWN:
+      default:
+         b.lo = nibble_transpose(move_rows(nibble_transpose(b.lo), row_right_table, score));
+         break;
+   }
+
+   return b;
+}
+
+void board_move_batch(board_t *boards, int count, direction_t dir,
+      int64_t *scores, uint8_t *moved)
+{
+   int i;
+   bool turn = dir == DIR_UP || dir == DIR_DOWN;
+   const uint16_t *table = dir == DIR_LEFT || dir == DIR_UP
+      ? row_left_table : row_right_table;
+
+   if (dir < DIR_UP || dir > DIR_LEFT)
+   {
+      if (moved)
+         memset(moved, 0, count);
+      return;
+   }
+
+   for (i = 0; i < count; i++)
+   {
+      board_t b = boards[i];
+
+      if (!board_narrow(b))
+         b = move_cells(b, dir, &scores[i]);
+      else if (turn)
+         b.lo = nibble_transpose(move_rows(nibble_transpose(b.lo), table, &scores[i]));
+      else
+         b.lo = move_rows(b.lo, table, &scores[i]);
+
+      if (moved)
+         moved[i] = !board_equal(b, boards[i]);
+      boards[i] = b;
+   }
+}
+
+static bool full_can_move(board_t b)
+{
+   int r;
+   int64_t dummy = 0;
+   uint64_t t;
+
+   /* a full board changes either way round iff it has a pair */
+   if (!board_narrow(b))
+      return !board_equal(move_cells(b, DIR_LEFT, &dummy), b) ||
+             !board_equal(move_cells(b, DIR_UP, &dummy), b);
+
+   t = nibble_transpose(b.lo);
+
+   for (r = 0; r < GRID_HEIGHT; r++)
+      if (row_moves_table[(b.lo >> (r * BOARD_ROW_BITS)) & BOARD_ROW_MASK] ||
+          row_moves_table[(t >> (r * BOARD_ROW_BITS)) & BOARD_ROW_MASK])
+         return true;
+
+   return false;
+}
+
+uint64_t board_empty_mask(board_t b)
+{
+   int r;
+   uint64_t mask = 0;
+
+   for (r = 0; r < GRID_HEIGHT; r++)
+      mask |= (uint64_t)row_empty_table[(b.lo >> (r * BOARD_ROW_BITS)) & BOARD_ROW_MASK]
+            << (r * GRID_WIDTH);
+
+   /* a zero nibble with its fifth bit set is 2^16 */
+   return mask & ~b.hi;
+}
+
+#else
+
+/* Slides one row of byte cells towards cell 0. The loop ends after
+ * the last tile, so sparse rows only cost a few iterations. */
+static uint64_t slide_row(uint64_t row, int64_t *score)
+{
+   int k = 0, prev = 0;
+   uint64_t out = 0;
+
+   for (; row; row >>= 8)
+   {
+      int v = (int)(row & 0xff);
+
+      if (!v)
+         continue;
+
+      if (v == prev && v < BOARD_MAX_EXPONENT)
+      {
+         out    += (uint64_t)1 << ((k - 1) << 3);
+         *score += (int64_t)2 << (v + 1);
+         prev    = 0;
+      }
+      else
+      {
+         out   |= (uint64_t)v << (k << 3);
+         prev   = v;
+         k++;
+      }
+   }
+
+   return out;
+}
+
+/* 8x8 byte matrix transpose in three rounds of block swaps: single
+ * bytes between neighbouring rows, then byte pairs two rows apart,
+ * then halves four rows apart. Smaller boards sit in the top-left
+ * corner with zero padding. */
+static board_t board_transpose(board_t b)
+{
+   static const uint64_t masks[3] = {
+      0x00FF00FF00FF00FFULL, 0x0000FFFF0000FFFFULL, 0x00000000FFFFFFFFULL
+   };
+   uint64_t m[8] = {0};
+   int r, s;
+
+   for (r = 0; r < GRID_HEIGHT; r++)
+      m[r] = b.row[r];
+
+   for (s = 0; s < 3; s++)
+   {
+      int d = 1 << s, shift = 8 << s;
+
+      for (r = 0; r < 8; r++)
+      {
+         uint64_t t;
+
+         if (r & d)
+            continue;
+
+         t         = ((m[r] >> shift) ^ m[r + d]) & masks[s];
+         m[r + d] ^= t;
+         m[r]     ^= t << shift;
+      }
+   }
+
+   for (r = 0; r < GRID_HEIGHT; r++)
+      b.row[r] = m[r];
+
+   return b;
+}
+
+#ifdef BOARD_SIMD
+/* Slides every column towards row 0, or towards the last row when
+ * 'reverse' is set. Each row is one vector, so a lane follows one
+ * column and all columns move in lockstep without branching on the
+ * tiles. Rows and columns swap roles on the transposed board. */
+static board_t slide_columns(board_t b, bool reverse, int64_t *score)
+{
+   lane_t c[GRID_HEIGHT];
+   lane_t zero = lane_set1(0);
+   lane_t cap  = lane_set1(BOARD_MAX_EXPONENT);
+   int i, j, k;
+
+   for (i = 0; i < GRID_HEIGHT; i++)
+      c[i] = lane_load(&b.row[reverse ? GRID_HEIGHT - 1 - i : i]);
+
+   /* pass i leaves the last i rows empty if there are that many gaps,
+    * so it need not look at them again */
+   for (i = 1; i < GRID_HEIGHT; i++)
+   {
+      for (j = 0; j < GRID_HEIGHT - i; j++)
+      {
+         lane_t gap = lane_eq(c[j], zero);
+
+         c[j]     = lane_or(c[j], lane_and(gap, c[j + 1]));
+         c[j + 1] = lane_andnot(gap, c[j + 1]);
+      }
+   }
+
+   for (j = 0; j < GRID_HEIGHT - 1; j++)
+   {
+      uint8_t merged[8];
+      lane_t m = lane_andnot(lane_eq(c[j], zero), lane_eq(c[j], c[j + 1]));
+
+      m = lane_andnot(lane_eq(c[j], cap), m);
+
+      if (!lane_any(m))
+         continue;
+
+      lane_store(merged, lane_and(m, c[j]));
+      for (k = 0; k < GRID_WIDTH; k++)
+         if (merged[k])
+            *score += (int64_t)2 << (merged[k] + 1);
+
+      /* m is all ones in merging lanes, subtracting it adds one */
+      c[j] = lane_sub(c[j], m);
+
+      for (k = j + 1; k < GRID_HEIGHT - 1; k++)
+         c[k] = lane_or(lane_and(m, c[k + 1]), lane_andnot(m, c[k]));
+      c[GRID_HEIGHT - 1] = lane_andnot(m, c[GRID_HEIGHT - 1]);
+   }
+
+   for (i = 0; i < GRID_HEIGHT; i++)
+      lane_store(&b.row[reverse ? GRID_HEIGHT - 1 - i : i], c[i]);
+
+   return b;
+}
+#endif
+
+/* byte rows are slid directly, there are no tables to build */
+void board_init_tables(void)
+{
+}
+
+#ifndef BOARD_SIMD
+static uint64_t reverse_row(uint64_t row)
+{
+   int j;
+   uint64_t out = 0;
+
+   for (j = 0; j < GRID_WIDTH; j++, row >>= 8)
+      out = (out << 8) | (row & 0xff);
+
+   return out;
+}
+
+static board_t move_rows(board_t b, bool reverse, int64_t *score)
+{
+   int r;
+
+   for (r = 0; r < GRID_HEIGHT; r++)
+   {
+      if (!b.row[r])
+         continue;
+
+      if (reverse)
+         b.row[r] = reverse_row(slide_row(reverse_row(b.row[r]), score));
+      else
+         b.row[r] = slide_row(b.row[r], score);
+   }
+
+   return b;
+}
+#endif
+
+board_t board_move(board_t b, direction_t dir, int64_t *score)
+{
+   int64_t dummy = 0;
+
+   if (!score)
+      score = &dummy;
+
+   switch (dir)
+   {
+#ifdef BOARD_SIMD
+      case DIR_LEFT:
+         return board_transpose(slide_columns(board_transpose(b), false, score));
+      case DIR_RIGHT:
+         return board_transpose(slide_columns(board_transpose(b), true, score));
+      case DIR_UP:
+         return slide_columns(b, false, score);
+      case DIR_DOWN:
+         return slide_columns(b, true, score);
+#else
+      case DIR_LEFT:
+         return move_rows(b, false, score);
+      case DIR_RIGHT:
+         return move_rows(b, true, score);
+      case DIR_UP:
+         return board_transpose(move_rows(board_transpose(b), false, score));
+      case DIR_DOWN:
+         return board_transpose(move_rows(board_transpose(b), true, score));
+#endif
+      default:
+         break;
+   }
+
+   return b;
+}
+
+void board_move_batch(board_t *boards, int count, direction_t dir,
+      int64_t *scores, uint8_t *moved)
+{
+   int i;
+#ifdef BOARD_SIMD
+   /* columns slide natively, rows on the transposed board */
+   bool turn    = dir == DIR_LEFT || dir == DIR_RIGHT;
+#else
+   bool turn    = dir == DIR_UP || dir == DIR_DOWN;
+#endif
+   bool reverse = dir == DIR_RIGHT || dir == DIR_DOWN;
+
+   if (dir < DIR_UP || dir > DIR_LEFT)
+   {
+      if (moved)
+         memset(moved, 0, count);
+      return;
+   }
+
+   if (turn)
+      for (i = 0; i < count; i++)
+         boards[i] = board_transpose(boards[i]);
+
+   for (i = 0; i < count; i++)
+   {
+#ifdef BOARD_SIMD
+      board_t b = slide_columns(boards[i], reverse, &scores[i]);
+#else
+      board_t b = move_rows(boards[i], reverse, &scores[i]);
+#endif
+
+      if (moved)
+         moved[i] = !board_equal(b, boards[i]);
+      boards[i] = b;
+   }
+
+   if (turn)
+      for (i = 0; i < count; i++)
+         boards[i] = board_transpose(boards[i]);
+}
+
+/* a full row changes iff it has a pair to merge, either way round */
+static bool rows_can_move(board_t b)
+{
+   int r;
+   int64_t dummy = 0;
+
+   for (r = 0; r < GRID_HEIGHT; r++)
+      if (slide_row(b.row[r], &dummy) != b.row[r])
+         return true;
+
+   return false;
+}
+
+static bool full_can_move(board_t b)
+{
+   return rows_can_move(b) || rows_can_move(board_transpose(b));
+}
+
+uint64_t board_empty_mask(board_t b)
+{
+   int r;
+   uint64_t mask = 0;
+
+   for (r = 0; r < GRID_HEIGHT; r++)
+   {
+      /* high bit of every zero byte, gathered into the low byte */
+      uint64_t x = b.row[r];
+
+      x = ~(((x & 0x7F7F7F7F7F7F7F7FULL) + 0x7F7F7F7F7F7F7F7FULL) | x | 0x7F7F7F7F7F7F7F7FULL);
+      x = ((x >> 7) * 0x0102040810204080ULL) >> 56;
+
+      mask |= (x & ((1 << GRID_WIDTH) - 1)) << (r * GRID_WIDTH);
+   }
+
+   return mask;
+}
+
+bool board_equal(board_t a, board_t b)
+{
+   int r;
+
+   for (r = 0; r < GRID_HEIGHT; r++)
+      if (a.row[r] != b.row[r])
+         return false;
+
+   return true;
+}
+
+#endif
+
+bool board_can_move(board_t b)
+{
+   /* a tile next to an empty cell can always slide into it, so only
+    * a full board needs its rows and columns checked */
+   uint64_t empty = board_empty_mask(b);
+
+   if (empty)
+      return empty != BOARD_CELL_MASK;
+
+   return full_can_move(b);
+}
+
+int board_count_empty(board_t b)
+{
+   return board_mask_count(board_empty_mask(b));
+}
+
+int board_mask_count(uint64_t mask)
+{
+#if defined(__GNUC__)
+   return __builtin_popcountll(mask);
+#else
+   mask = mask - ((mask >> 1) & 0x5555555555555555ULL);
+   mask = (mask & 0x3333333333333333ULL) + ((mask >> 2) & 0x3333333333333333ULL);
+   mask = (mask + (mask >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+   return (int)((mask * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+int board_mask_lowest(uint64_t mask)
+{
+#if defined(__GNUC__)
+   return __builtin_ctzll(mask);
+#else
+   static const uint8_t debruijn[64] = {
+       0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+      62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+      63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+      46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6
+   };
+
+   return debruijn[((mask & (0 - mask)) * 0x03F79D71B4CB0A89ULL) >> 58];
+#endif
+}
+
+int board_mask_select(uint64_t mask, int n)
+{
+   while (n-- > 0)
+      mask &= mask - 1;
+
+   return board_mask_lowest(mask);
+}
+
+int board_max_exponent(board_t b)
+{
+   int i, max = 0;
+
+   for (i = 0; i < GRID_SIZE; i++)
+      if (board_get(b, i) > max)
+         max = board_get(b, i);
+
+   return max;
+}
+
+bool board_valid(board_t b)
+{
+   int i;
+   board_t cells;
+
+   board_clear(cells);
+
+   for (i = 0; i < GRID_SIZE; i++)
+   {
+      if (board_get(b, i) > BOARD_MAX_EXPONENT)
+         return false;
+
+      board_set(cells, i, board_get(b, i));
+   }
+
+   /* anything the cells do not account for is a stray bit */
+   return board_equal(cells, b);
+}
+
+board_t board_add_tile(board_t b, int n, int value, int *cell)
+{
+   int i = board_mask_select(board_empty_mask(b), n);
+
+   board_set(b, i, value);
+
+   if (cell)
+      *cell = i;
+
+   return b;
+}
+
+void board_spawn_batch(board_t *boards, rng_t *rngs, const uint8_t *live, int count)
+{
+   int i;
+
+   for (i = 0; i < count; i++)
+   {
+      uint64_t empty = board_empty_mask(boards[i]);
+      int cell;
+
+      if (!live[i] || !empty)
+         continue;
+
+      cell = board_mask_select(empty, (int)rng_range(&rngs[i], board_mask_count(empty)));
+      board_set(boards[i], cell, rng_range(&rngs[i], 10) ? 1 : 2);
+   }
+}
+
+void board_trace(board_t from, board_t to, direction_t dir,
+      int *src, int *merged)
+{
+   int i, l, j;
+
+   for (i = 0; i < GRID_SIZE; i++)
+   {
+      src[i]    = board_get(from, i) ? i : -1;
+      merged[i] = -1;
+   }
+
+   if (dir == DIR_NONE)
+      return;
+
+   for (l = 0; l < GRID_WIDTH; l++)
+   {
+      int cells[GRID_WIDTH], in[GRID_WIDTH], out[GRID_WIDTH], dest[GRID_WIDTH];
+      bool changed = false;
+
+      for (j = 0; j < GRID_WIDTH; j++)
+      {
+         cells[j] = line_cell(dir, l, j);
+         in[j]    = board_get(from, cells[j]);
+
+         if (in[j] != board_get(to, cells[j]))
+            changed = true;
+      }
+
+      if (!changed)
+         continue;
+
+      slide_line(in, out, dest, GRID_WIDTH);
+
+      for (j = 0; j < GRID_WIDTH; j++)
+         src[cells[j]] = -1;
+
+      /* walking from the wall, the first tile to land on a cell is the
+       * one that stays, a second one is merged into it */
+      for (j = 0; j < GRID_WIDTH; j++)
+      {
+         int d;
+
+         if (dest[j] < 0)
+            continue;
+
+         d = cells[dest[j]];
+
+         if (src[d] < 0)
+            src[d] = cells[j];
+         else
+            merged[d] = cells[j];
+      }
+   }
+}
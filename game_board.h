@@ -0,0 +1,114 @@
+#ifndef _GAME_BOARD_H
+#define _GAME_BOARD_H
+
+#include <stdint.h>
+#include <string.h>
+#include <boolean.h>
+#include <retro_inline.h>
+
+#include "game.h"
+#include "game_rng.h"
+
+/* board_t packs one tile exponent per cell, row-major, cell 0 in the
+ * lowest bits.
+ *
+ * Up to 4x4 the low four bits of every exponent are nibbles in 'lo'
+ * and the fifth bit of cell i is bit i of 'hi'. A row of 'lo' fits in
+ * 16 bits, so a move is a handful of lookups into precomputed row
+ * tables. Boards with tiles past 2^15, or two 2^15 tiles that might
+ * merge, slide cell by cell instead.
+ *
+ * Larger boards use a byte per cell and one uint64_t per row. Rows are
+ * slid with word operations, columns the same way on the transposed
+ * board. */
+
+#if BOARD_CELL_BITS == 4
+
+#define BOARD_ROW_BITS      (4 * GRID_WIDTH)
+#define BOARD_ROW_MASK      ((1 << BOARD_ROW_BITS) - 1)
+#define BOARD_ROW_COUNT     (1 << BOARD_ROW_BITS)
+
+#define BOARD_MAX_EXPONENT  MAX_TILE_EXPONENT
+
+#define board_get(b, i)     ((int)((((b).lo >> ((i) << 2)) & 0xf) | \
+                                   ((((b).hi >> (i)) & 1) << 4)))
+#define board_set(b, i, v)  ((b) = board_with(b, i, v))
+#define board_equal(a, b)   ((a).lo == (b).lo && (a).hi == (b).hi)
+#define board_clear(b)      ((b).lo = 0, (b).hi = 0)
+
+static INLINE board_t board_with(board_t b, int i, int v)
+{
+   b.lo = (b.lo & ~((uint64_t)0xf << (i << 2))) | ((uint64_t)(v & 0xf) << (i << 2));
+   b.hi = (b.hi & ~((uint64_t)1 << i)) | ((uint64_t)((v >> 4) & 1) << i);
+   return b;
+}
+
+#else
+
+#define BOARD_MAX_EXPONENT  MAX_TILE_EXPONENT
+
+#define BOARD_CELL_SHIFT(i) (((i) % GRID_WIDTH) << 3)
+
+#define board_get(b, i)     ((int)(((b).row[(i) / GRID_WIDTH] >> BOARD_CELL_SHIFT(i)) & 0xff))
+#define board_set(b, i, v)  ((b).row[(i) / GRID_WIDTH] = \
+      ((b).row[(i) / GRID_WIDTH] & ~((uint64_t)0xff << BOARD_CELL_SHIFT(i))) | \
+      ((uint64_t)(v) << BOARD_CELL_SHIFT(i)))
+#define board_clear(b)      memset(&(b), 0, sizeof(board_t))
+
+bool board_equal(board_t a, board_t b);
+
+#endif
+
+/* one bit per cell, bit i for cell i */
+#define BOARD_CELL_MASK     (~(uint64_t)0 >> (64 - GRID_SIZE))
+
+void board_init_tables(void);
+
+board_t board_move(board_t b, direction_t dir, int64_t *score);
+bool board_can_move(board_t b);
+int board_count_empty(board_t b);
+int board_max_exponent(board_t b);
+
+/* Every cell holds an exponent up to BOARD_MAX_EXPONENT and no bit is
+ * set outside the cells. Moves assume both, so boards read from
+ * outside are checked first. */
+bool board_valid(board_t b);
+
+/* Cells holding no tile, a constant amount of work per row. */
+uint64_t board_empty_mask(board_t b);
+
+int board_mask_count(uint64_t mask);
+/* index of the lowest set bit, mask must not be 0 */
+int board_mask_lowest(uint64_t mask);
+/* index of the n-th (0-based) set bit, n < board_mask_count(mask) */
+int board_mask_select(uint64_t mask, int n);
+
+/* Puts a tile of exponent 'value' on the n-th empty cell (0-based) and
+ * stores that cell's index in *cell. */
+board_t board_add_tile(board_t b, int n, int value, int *cell);
+
+/* Batch forms of board_move() and of the game's tile spawn, for
+ * workloads that step many boards together (rollouts, self-play).
+ * Boards, scores and RNGs are parallel arrays and nothing here touches
+ * the animation state of cell_t.
+ *
+ * board_move_batch() moves boards[0..count) in 'dir' in place and adds
+ * each merge score to scores[i]; moved[i], if given, tells whether
+ * board i changed. The direction is resolved once per call and the
+ * batch is walked without branching on the boards, save for nibble
+ * boards that have outgrown the row tables.
+ *
+ * board_spawn_batch() puts a tile on every board with live[i] set,
+ * drawn from rngs[i] the same way the game draws its spawns. */
+void board_move_batch(board_t *boards, int count, direction_t dir,
+      int64_t *scores, uint8_t *moved);
+void board_spawn_batch(board_t *boards, rng_t *rngs, const uint8_t *live, int count);
+
+/* Works out where every tile of 'from' went when 'dir' produced 'to'.
+ * src[i] is the cell the tile now in cell i came from (-1 if empty),
+ * merged[i] the cell of the tile that merged into it (-1 if none).
+ * Only lines that differ between the two boards are walked. */
+void board_trace(board_t from, board_t to, direction_t dir,
+      int *src, int *merged);
+
+#endif
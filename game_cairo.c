@@ -7,7 +7,6 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
-#include <time.h>
 #include <assert.h>
 
 #include <cairo/cairo.h>
@@ -18,14 +17,13 @@ static cairo_surface_t *surface = NULL;
 static cairo_surface_t *static_surface = NULL;
 static cairo_t *ctx = NULL;
 static cairo_pattern_t* color_lut[13];
-static const char* label_lut[13] =
-{
-   "",
-   "2", "4", "8", "16",
-   "32", "64", "128", "256",
-   "512", "1024", "2048",
-   "XXX"
-};
+static char label_lut[MAX_TILE_EXPONENT + 1][8];
+
+// panel numbers, formatted when they change
+static number_text_t score_text;
+static number_text_t best_text;
+static number_text_t delta_text;
+static number_text_t total_text;
 
 static uint16_t *frame_buf;
 
@@ -62,12 +60,41 @@ static void draw_text_centered(cairo_t *ctx, const char *utf8, int x, int y, int
    draw_text(ctx, utf8, x + font_off_x, y + font_off_y);
 }
 
-static void draw_tile(cairo_t *ctx, cell_t *cell)
+// hint arrow over the middle of the board
+static void draw_hint(cairo_t *ctx)
+{
+   double half     = TILE_SIZE * 3 / 8.0;
+   direction_t dir = game_get_hint();
+
+   if (dir == DIR_NONE)
+      return;
+
+   cairo_save(ctx);
+   cairo_translate(ctx, (SCREEN_WIDTH) / 2.0, BOARD_OFFSET_Y + BOARD_HEIGHT / 2.0);
+   cairo_rotate(ctx, (dir - DIR_UP) * M_PI / 2);
+
+   // pointing up before the rotation
+   cairo_move_to(ctx, 0, -half);
+   cairo_line_to(ctx, half * 0.75, 0);
+   cairo_line_to(ctx, half * 0.25, 0);
+   cairo_line_to(ctx, half * 0.25, half);
+   cairo_line_to(ctx, -half * 0.25, half);
+   cairo_line_to(ctx, -half * 0.25, 0);
+   cairo_line_to(ctx, -half * 0.75, 0);
+   cairo_close_path(ctx);
+
+   set_rgba(ctx, 119, 110, 101, 0.8);
+   cairo_fill(ctx);
+   cairo_restore(ctx);
+}
+
+static void draw_tile(cairo_t *ctx, const cell_t *cell)
 {
    int x, y;
    int w = TILE_SIZE, h = TILE_SIZE;
    int font_size = FONT_SIZE;
-   float *frame_time = game_get_frame_time();
+   // 4096 and up share the last entry
+   int lut = cell->value < 12 ? cell->value : 12;
 
    if (cell->value && cell->move_time < 1)
    {
@@ -82,8 +109,6 @@ static void draw_tile(cairo_t *ctx, cell_t *cell)
 
       if (cell->move_time < 0.5 && cell->source)
          draw_tile(ctx, cell->source);
-
-      cell->move_time += *frame_time * TILE_ANIM_SPEED;
    }
    else if (cell->appear_time < 1)
    {
@@ -97,24 +122,26 @@ static void draw_tile(cairo_t *ctx, cell_t *cell)
 
       x += TILE_SIZE/2 - w/2;
       y += TILE_SIZE/2 - h/2;
-
-      cell->appear_time += *frame_time * TILE_ANIM_SPEED;
    } else {
       grid_to_screen(cell->pos, &x, &y);
    }
 
-   cairo_set_source(ctx, color_lut[cell->value]);
+   cairo_set_source(ctx, color_lut[lut]);
    fill_rectangle(ctx, x, y, w, h);
 
    if (cell->value) {
+      size_t len = strlen(label_lut[cell->value]);
+
       cairo_select_font_face(ctx, FONT, CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
 
-      if (cell->value < 6) // one or two digits
+      if (len <= 2)
          cairo_set_font_size(ctx, font_size * 2.0);
-      else if (cell->value < 10) // three digits
+      else if (len == 3)
          cairo_set_font_size(ctx, font_size * 1.5);
-      else // four digits
+      else if (len == 4)
          cairo_set_font_size(ctx, font_size);
+      else // 16384 to 65536
+         cairo_set_font_size(ctx, font_size * 0.8);
 
       set_rgb(ctx, 119, 110, 101);
       draw_text_centered(ctx, label_lut[cell->value], x, y, w, h);
@@ -128,6 +155,8 @@ void game_calculate_pitch(void)
 
 static void init_luts(void)
 {
+   int i;
+
    color_lut[0] = cairo_pattern_create_rgba(238 / 255.0, 228 / 255.0, 218 / 255.0, 0.35);
    color_lut[1] = cairo_pattern_create_rgb(238 / 255.0, 228 / 255.0, 218 / 255.0);
 
@@ -144,6 +173,9 @@ static void init_luts(void)
    color_lut[10] = cairo_pattern_create_rgb(237 / 255.0, 197 / 255.0, 63 / 255.0);
    color_lut[11] = cairo_pattern_create_rgb(237 / 255.0, 194 / 255.0, 46 / 255.0);
    color_lut[12] = cairo_pattern_create_rgb(60 / 255.0, 58 / 255.0, 50 / 255.0);
+
+   for (i = 0; i <= MAX_TILE_EXPONENT; i++)
+      format_tile_label(label_lut[i], sizeof(label_lut[i]), i);
 }
 
 static void init_static_surface(void)
@@ -165,11 +197,11 @@ static void init_static_surface(void)
 
    // score bg
    set_rgb(static_ctx, 185, 172, 159);
-   fill_rectangle(static_ctx, SPACING, SPACING, TILE_SIZE*2+SPACING*2, TILE_SIZE);
+   fill_rectangle(static_ctx, SPACING, SPACING, PANEL_WIDTH, TILE_SIZE);
 
    // best bg
    set_rgb(static_ctx, 185, 172, 159);
-   fill_rectangle(static_ctx, TILE_SIZE*2+SPACING*4, SPACING, TILE_SIZE*2+SPACING*2, TILE_SIZE);
+   fill_rectangle(static_ctx, BEST_OFFSET_X, SPACING, PANEL_WIDTH, TILE_SIZE);
 
    cairo_select_font_face(static_ctx, FONT, CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
    cairo_set_font_size(static_ctx, FONT_SIZE);
@@ -180,7 +212,7 @@ static void init_static_surface(void)
 
    // best title
    cairo_set_source(static_ctx, color_lut[1]);
-   draw_text_centered(static_ctx, "BEST", TILE_SIZE*2+SPACING*5, SPACING*2, 0, 0);
+   draw_text_centered(static_ctx, "BEST", BEST_OFFSET_X + SPACING, SPACING*2, 0, 0);
 
    // draw background cells
    dummy.move_time = 1;
@@ -188,9 +220,9 @@ static void init_static_surface(void)
    dummy.source = NULL;
    dummy.value = 0;
 
-   for (row = 0; row < 4; row++)
+   for (row = 0; row < GRID_HEIGHT; row++)
    {
-      for (col = 0; col < 4; col++)
+      for (col = 0; col < GRID_WIDTH; col++)
       {
          dummy.pos.x = col;
          dummy.pos.y = row;
@@ -205,7 +237,6 @@ static void init_static_surface(void)
 void game_init(void)
 {
    frame_buf = calloc(SCREEN_HEIGHT, SCREEN_PITCH);
-   srand(time(NULL));
 
    surface = cairo_image_surface_create_for_data(
             (unsigned char*)frame_buf, CAIRO_FORMAT_RGB16_565, SCREEN_WIDTH, SCREEN_HEIGHT,
@@ -224,6 +255,8 @@ void game_deinit(void)
 {
    int i;
 
+   deinit_game();
+
    for (i = 0; i < 13; i++)
    {
       cairo_pattern_destroy(color_lut[i]);
@@ -245,11 +278,14 @@ void game_deinit(void)
 
 void render_playing(void)
 {
-   int *delta_score;
-   float *delta_score_time;
-   char tmp[10] = {0};
+   float delta_score_time;
+   char tmp[20] = {0};
+   const cell_t *grid;
    float *frame_time = game_get_frame_time();
 
+   anim_sync(game_get_board());
+   grid = anim_cells();
+
    // paint static background
    cairo_set_source_surface(ctx, static_surface, 0, 0);
    cairo_paint(ctx);
@@ -259,30 +295,28 @@ void render_playing(void)
 
    // score and best score value
    set_rgb(ctx, 255, 255, 255);
-   sprintf(tmp, "%i", game_get_score() % 1000000);
-   draw_text_centered(ctx, tmp, SPACING*2, SPACING * 5, TILE_SIZE*2, 0);
+   draw_text_centered(ctx, number_text(&score_text, game_get_score(), 6), SPACING*2, SPACING * 5, PANEL_WIDTH - SPACING*2, 0);
 
-   sprintf(tmp, "%i", game_get_best_score() % 1000000);
    cairo_set_source(ctx, color_lut[1]);
-   draw_text_centered(ctx, tmp, TILE_SIZE*2+SPACING*5, SPACING * 5, TILE_SIZE*2, 0);
+   draw_text_centered(ctx, number_text(&best_text, game_get_best_score(), 6), BEST_OFFSET_X + SPACING, SPACING * 5, PANEL_WIDTH - SPACING*2, 0);
 
-   for (int row = 0; row < 4; row++)
+   for (int row = 0; row < GRID_HEIGHT; row++)
    {
-      for (int col = 0; col < 4; col++)
+      for (int col = 0; col < GRID_WIDTH; col++)
       {
-         cell_t *grid = game_get_grid();
-         cell_t *cell = &grid[row * 4 + col];
+         const cell_t *cell = &grid[row * GRID_WIDTH + col];
 
          if (cell->value)
             draw_tile(ctx, cell);
       }
    }
 
-   delta_score_time = game_get_delta_score_time();
-   delta_score = game_get_delta_score();
+   draw_hint(ctx);
+
+   delta_score_time = anim_delta_score_time();
 
    // draw +score animation
-   if (*delta_score_time < 1)
+   if (delta_score_time < 1)
    {
       cairo_select_font_face(ctx, FONT, CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
       cairo_set_font_size(ctx, FONT_SIZE * 1.2);
@@ -290,16 +324,16 @@ void render_playing(void)
       int x = SPACING * 2;
       int y = SPACING * 5;
 
-      y = lerp(y, y - TILE_SIZE, *delta_score_time);
+      y = lerp(y, y - TILE_SIZE, delta_score_time);
 
-      set_rgba(ctx, 119, 110, 101, lerp(1, 0, *delta_score_time));
+      set_rgba(ctx, 119, 110, 101, lerp(1, 0, delta_score_time));
 
-      sprintf(tmp, "+%i", *delta_score);
+      sprintf(tmp, "+%s", number_text(&delta_text, anim_delta_score(), 6));
       draw_text_centered(ctx, tmp, x, y, TILE_SIZE * 2, TILE_SIZE);
-
-      *delta_score_time += *frame_time;
    }
 
+   anim_advance(*frame_time);
+
    cairo_surface_flush(surface);
 }
 
@@ -317,13 +351,13 @@ void render_title(void)
 
 
    set_rgb(ctx, 185, 172, 159);
-   fill_rectangle(ctx, TILE_SIZE / 2, TILE_SIZE * 4, SCREEN_HEIGHT - TILE_SIZE * 2, FONT_SIZE * 3);
+   fill_rectangle(ctx, TILE_SIZE / 2, MESSAGE_OFFSET_Y, SCREEN_HEIGHT - TILE_SIZE * 2, FONT_SIZE * 3);
 
    cairo_select_font_face(ctx, FONT, CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
    cairo_set_font_size(ctx, FONT_SIZE);
 
    cairo_set_source(ctx, color_lut[1]);
-   draw_text_centered(ctx, "PRESS START", TILE_SIZE / 2 + SPACING, TILE_SIZE * 4 + SPACING,
+   draw_text_centered(ctx, "PRESS START", TILE_SIZE / 2 + SPACING, MESSAGE_OFFSET_Y + SPACING,
                       SCREEN_HEIGHT - TILE_SIZE * 2 - SPACING * 2, FONT_SIZE * 3 - SPACING * 2);
 
 }
@@ -351,25 +385,29 @@ void render_win_or_game_over(void)
 
    set_rgb(ctx, 185, 172, 159);
 
-   sprintf(tmp, "Score: %i", game_get_score());
+   sprintf(tmp, "Score: %s", number_text(&total_text, game_get_score(), 12));
    draw_text_centered(ctx, tmp, 0, 0, SCREEN_WIDTH, TILE_SIZE*5);
 
    set_rgb(ctx, 185, 172, 159);
-   fill_rectangle(ctx, TILE_SIZE / 2, TILE_SIZE * 4, SCREEN_HEIGHT - TILE_SIZE * 2, FONT_SIZE * 3);
+   fill_rectangle(ctx, TILE_SIZE / 2, MESSAGE_OFFSET_Y, SCREEN_HEIGHT - TILE_SIZE * 2, FONT_SIZE * 3);
    cairo_set_source(ctx, color_lut[1]);
-   draw_text_centered(ctx, "PRESS START", TILE_SIZE / 2 + SPACING, TILE_SIZE * 4 + SPACING,
+   draw_text_centered(ctx, "PRESS START", TILE_SIZE / 2 + SPACING, MESSAGE_OFFSET_Y + SPACING,
                       SCREEN_HEIGHT - TILE_SIZE * 2 - SPACING * 2, FONT_SIZE * 3 - SPACING * 2);
 }
 
 void render_paused(void)
 {
    char tmp[100];
+   stats_t stats;
    render_playing();
 
    // bg
    set_rgba(ctx, 250, 248, 239, 0.85);
    fill_rectangle(ctx, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
 
+   // the overlay fades the board, keep its hint in view
+   draw_hint(ctx);
+
    cairo_select_font_face(ctx, FONT, CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
    cairo_set_font_size(ctx, FONT_SIZE * 2);
 
@@ -381,15 +419,35 @@ void render_paused(void)
 
    set_rgb(ctx, 185, 172, 159);
 
-   sprintf(tmp, "Score: %i", game_get_score());
+   sprintf(tmp, "Score: %s", number_text(&total_text, game_get_score(), 12));
    draw_text_centered(ctx, tmp, 0, 0, SCREEN_WIDTH, TILE_SIZE*5);
 
+   // where greedy play goes from here
+   cairo_set_font_size(ctx, FONT_SIZE * 0.6);
+   stats.rollouts = 0;
+   if (game_get_stats(&stats))
+   {
+      sprintf(tmp, "%s %.0f%%  %s %.0f%%  %s %.0f%%",
+            label_lut[stats.target[0]], stats.reach[0] * 100,
+            label_lut[stats.target[1]], stats.reach[1] * 100,
+            label_lut[stats.target[2]], stats.reach[2] * 100);
+      draw_text_centered(ctx, tmp, 0, 0, SCREEN_WIDTH, TILE_SIZE*5 + FONT_SIZE*5/4);
+      sprintf(tmp, "Greedy rollouts: score %.0f", stats.mean_score);
+      draw_text_centered(ctx, tmp, 0, 0, SCREEN_WIDTH, TILE_SIZE*5 + FONT_SIZE*5/2);
+   }
+   else if (stats.rollouts)
+   {
+      sprintf(tmp, "Rollouts %i/%i", stats.done, stats.rollouts);
+      draw_text_centered(ctx, tmp, 0, 0, SCREEN_WIDTH, TILE_SIZE*5 + FONT_SIZE*5/4);
+   }
+   cairo_set_font_size(ctx, FONT_SIZE);
+
    set_rgb(ctx, 185, 172, 159);
-   fill_rectangle(ctx, TILE_SIZE / 2, TILE_SIZE * 4, SCREEN_HEIGHT - TILE_SIZE * 2, FONT_SIZE * 5);
+   fill_rectangle(ctx, TILE_SIZE / 2, MESSAGE_OFFSET_Y, SCREEN_HEIGHT - TILE_SIZE * 2, FONT_SIZE * 5);
    cairo_set_source(ctx, color_lut[1]);
-   draw_text_centered(ctx, "SELECT: New Game", TILE_SIZE / 2 + SPACING, TILE_SIZE * 4 + SPACING,
+   draw_text_centered(ctx, "SELECT: New Game", TILE_SIZE / 2 + SPACING, MESSAGE_OFFSET_Y + SPACING,
                       SCREEN_HEIGHT - TILE_SIZE * 2 - SPACING * 2, FONT_SIZE * 3 - SPACING * 2);
-   draw_text_centered(ctx, "START: Continue", TILE_SIZE / 2 + SPACING, TILE_SIZE * 4 + SPACING + FONT_SIZE * 2,
+   draw_text_centered(ctx, "START: Continue", TILE_SIZE / 2 + SPACING, MESSAGE_OFFSET_Y + SPACING + FONT_SIZE * 2,
                       SCREEN_HEIGHT - TILE_SIZE * 2 - SPACING * 2, FONT_SIZE * 3 - SPACING * 2);
 }
 
@@ -0,0 +1,200 @@
+#include "game_hint.h"
+#include "game_ai.h"
+#include "game_thread.h"
+
+/* a background search can afford to look further than autoplay */
+#define HINT_BUDGET_USEC 250000
+
+/* last result the caller saw, so a contended lock costs nothing */
+static board_t seen_board;
+static direction_t seen_dir = DIR_NONE;
+
+#ifdef HAVE_GAME_THREADS
+
+static game_thread_t *hint_thread = NULL;
+static game_mutex_t *hint_lock    = NULL;
+static game_cond_t *hint_wake     = NULL;
+static game_cond_t *hint_idle     = NULL;
+
+static bool hint_pending = false;
+static bool hint_busy    = false;
+static bool hint_quit    = false;
+static board_t hint_board;
+static volatile int hint_abort = 0;
+
+static board_t result_board;
+static direction_t result_dir = DIR_NONE;
+
+static void hint_main(void *data)
+{
+   (void)data;
+
+   game_mutex_lock(hint_lock);
+
+   for (;;)
+   {
+      board_t b;
+      direction_t dir;
+
+      while (!hint_quit && !hint_pending)
+         game_cond_wait(hint_wake, hint_lock);
+
+      if (hint_quit)
+         break;
+
+      b            = hint_board;
+      hint_pending = false;
+      hint_busy    = true;
+      hint_abort   = 0;
+
+      game_mutex_unlock(hint_lock);
+      dir = ai_best_move_cancellable(b, AI_MAX_DEPTH, HINT_BUDGET_USEC, &hint_abort);
+      game_mutex_lock(hint_lock);
+
+      /* a cancelled search only got part of the way */
+      if (!hint_abort)
+      {
+         result_board = b;
+         result_dir   = dir;
+      }
+
+      hint_busy = false;
+      game_cond_broadcast(hint_idle);
+   }
+
+   game_mutex_unlock(hint_lock);
+}
+
+void hint_init(void)
+{
+   hint_deinit();
+
+   hint_lock = game_mutex_create();
+   hint_wake = game_cond_create();
+   hint_idle = game_cond_create();
+
+   hint_quit    = false;
+   hint_pending = false;
+   hint_busy    = false;
+   result_dir   = DIR_NONE;
+
+   if (hint_lock && hint_wake && hint_idle)
+      hint_thread = game_thread_create(hint_main, NULL);
+
+   if (!hint_thread)
+      hint_deinit();
+}
+
+void hint_deinit(void)
+{
+   if (hint_thread)
+   {
+      game_mutex_lock(hint_lock);
+      hint_quit  = true;
+      hint_abort = 1;
+      game_cond_signal(hint_wake);
+      game_mutex_unlock(hint_lock);
+
+      game_thread_join(hint_thread);
+   }
+
+   game_cond_free(hint_idle);
+   game_cond_free(hint_wake);
+   game_mutex_free(hint_lock);
+
+   hint_thread = NULL;
+   hint_idle   = NULL;
+   hint_wake   = NULL;
+   hint_lock   = NULL;
+   seen_dir    = DIR_NONE;
+}
+
+void hint_request(board_t b, retro_time_t budget_usec)
+{
+   if (!hint_thread)
+   {
+      /* no thread to hand it to, search within a frame instead */
+      seen_board = b;
+      seen_dir   = ai_best_move(b, AI_MAX_DEPTH, budget_usec);
+      return;
+   }
+
+   game_mutex_lock(hint_lock);
+   hint_board   = b;
+   hint_pending = true;
+   hint_abort   = 1;
+   game_cond_signal(hint_wake);
+   game_mutex_unlock(hint_lock);
+}
+
+void hint_cancel(void)
+{
+   if (!hint_thread)
+      return;
+
+   /* the lock keeps the worker from picking the request up after
+    * this; a search already running polls hint_abort */
+   game_mutex_lock(hint_lock);
+   hint_pending = false;
+   hint_abort   = 1;
+   game_mutex_unlock(hint_lock);
+}
+
+void hint_stop(void)
+{
+   if (!hint_thread)
+      return;
+
+   game_mutex_lock(hint_lock);
+   hint_pending = false;
+   hint_abort   = 1;
+   while (hint_busy)
+      game_cond_wait(hint_idle, hint_lock);
+   game_mutex_unlock(hint_lock);
+}
+
+direction_t hint_get(board_t b)
+{
+   if (hint_thread && game_mutex_trylock(hint_lock))
+   {
+      seen_board = result_board;
+      seen_dir   = result_dir;
+      game_mutex_unlock(hint_lock);
+   }
+
+   return seen_dir != DIR_NONE && board_equal(seen_board, b) ? seen_dir : DIR_NONE;
+}
+
+#else
+
+void hint_init(void)
+{
+   seen_dir = DIR_NONE;
+}
+
+void hint_deinit(void)
+{
+   seen_dir = DIR_NONE;
+}
+
+void hint_request(board_t b, retro_time_t budget_usec)
+{
+   /* no thread to hand it to, search within a frame instead */
+   seen_board = b;
+   seen_dir   = ai_best_move(b, AI_MAX_DEPTH, budget_usec);
+}
+
+void hint_cancel(void)
+{
+}
+
+void hint_stop(void)
+{
+}
+
+direction_t hint_get(board_t b)
+{
+   return seen_dir != DIR_NONE && board_equal(seen_board, b) ? seen_dir : DIR_NONE;
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef _GAME_HINT_H
+#define _GAME_HINT_H
+
+#include <boolean.h>
+
+#include "game_board.h"
+
+/* Best move search for the hint overlay, on a thread of its own in
+ * HAVE_GAME_THREADS builds. Requests never wait for a search: a new
+ * one cancels the running one, and results are kept together with the
+ * board they belong to so a stale one is never handed out. */
+
+void hint_init(void);
+void hint_deinit(void);
+
+/* Starts a search for 'b', dropping any search still running. Without
+ * a thread the search runs right here, for at most 'budget_usec'. */
+void hint_request(board_t b, retro_time_t budget_usec);
+
+/* Drops a request not yet picked up and stops the running search,
+ * without waiting for it. */
+void hint_cancel(void);
+
+/* Cancels and waits until the AI is no longer in use, for callers
+ * about to change its settings. */
+void hint_stop(void);
+
+/* The best move for 'b' if a finished search has one, DIR_NONE
+ * otherwise. Never blocks. */
+direction_t hint_get(board_t b);
+
+#endif
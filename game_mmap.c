@@ -0,0 +1,140 @@
+#include <stdlib.h>
+
+#include "game_mmap.h"
+
+#ifdef HAVE_GAME_MMAP
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+struct game_map
+{
+#ifdef _WIN32
+   HANDLE file;
+   HANDLE mapping;
+#endif
+   void *data;
+   size_t size;
+};
+
+game_map_t *game_map_file(const char *path)
+{
+   game_map_t *map = (game_map_t *)calloc(1, sizeof(*map));
+#ifdef _WIN32
+   LARGE_INTEGER size;
+#else
+   int fd;
+   struct stat st;
+#endif
+
+   if (!map)
+      return NULL;
+
+#ifdef _WIN32
+   map->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (map->file == INVALID_HANDLE_VALUE)
+      goto error;
+
+   if (!GetFileSizeEx(map->file, &size) || !size.QuadPart)
+      goto error;
+
+   map->size    = (size_t)size.QuadPart;
+   map->mapping = CreateFileMappingA(map->file, NULL, PAGE_READONLY, 0, 0, NULL);
+   if (!map->mapping)
+      goto error;
+
+   if (!(map->data = MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0)))
+      goto error;
+#else
+   if ((fd = open(path, O_RDONLY)) < 0)
+      goto error;
+
+   if (fstat(fd, &st) || !st.st_size)
+   {
+      close(fd);
+      goto error;
+   }
+
+   map->size = (size_t)st.st_size;
+   map->data = mmap(NULL, map->size, PROT_READ, MAP_SHARED, fd, 0);
+
+   /* the mapping keeps the file alive */
+   close(fd);
+
+   if (map->data == MAP_FAILED)
+   {
+      map->data = NULL;
+      goto error;
+   }
+#endif
+
+   return map;
+
+error:
+   game_unmap_file(map);
+   return NULL;
+}
+
+void game_unmap_file(game_map_t *map)
+{
+   if (!map)
+      return;
+
+#ifdef _WIN32
+   if (map->data)
+      UnmapViewOfFile(map->data);
+   if (map->mapping)
+      CloseHandle(map->mapping);
+   if (map->file && map->file != INVALID_HANDLE_VALUE)
+      CloseHandle(map->file);
+#else
+   if (map->data)
+      munmap(map->data, map->size);
+#endif
+
+   free(map);
+}
+
+const void *game_map_data(const game_map_t *map)
+{
+   return map->data;
+}
+
+size_t game_map_size(const game_map_t *map)
+{
+   return map->size;
+}
+
+#else
+
+game_map_t *game_map_file(const char *path)
+{
+   (void)path;
+   return NULL;
+}
+
+void game_unmap_file(game_map_t *map)
+{
+   (void)map;
+}
+
+const void *game_map_data(const game_map_t *map)
+{
+   (void)map;
+   return NULL;
+}
+
+size_t game_map_size(const game_map_t *map)
+{
+   (void)map;
+   return 0;
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef _GAME_MMAP_H
+#define _GAME_MMAP_H
+
+#include <stddef.h>
+
+/* Read-only file mapping, only available in HAVE_GAME_MMAP builds.
+ * Callers fall back to reading the file into memory without it. */
+
+typedef struct game_map game_map_t;
+
+/* NULL on failure or without HAVE_GAME_MMAP. */
+game_map_t *game_map_file(const char *path);
+void game_unmap_file(game_map_t *map);
+
+const void *game_map_data(const game_map_t *map);
+size_t game_map_size(const game_map_t *map);
+
+#endif
@@ -6,7 +6,6 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
-#include <time.h>
 #include <assert.h>
 
 extern bool libretro_supports_sw_fb;
@@ -15,17 +14,15 @@ extern void log_2048(enum retro_log_level level, const char *format, ...);
 
 int SCREEN_PITCH = 0;
 
-static unsigned int color_lut[18];
-static unsigned int color_lut_dark[18];
-static const char* label_lut[18] =
-{
-   "",
-   "2", "4", "8", "16",
-   "32", "64", "128", "256",
-   "512", "1024", "2048",
-   "4096", "8192", "16384",
-   "32768", "65536", "131072"
-};
+static unsigned int color_lut[MAX_TILE_EXPONENT + 1];
+static unsigned int color_lut_dark[MAX_TILE_EXPONENT + 1];
+static char label_lut[MAX_TILE_EXPONENT + 1][8];
+
+/* panel numbers, formatted when they change */
+static number_text_t score_text;
+static number_text_t best_text;
+static number_text_t delta_text;
+static number_text_t total_text;
 
 /* LAME DRAW TEXT and FILLRECT */
 
@@ -61,95 +58,167 @@ void initgraph(void)
 #endif
 }
 
+/* Wide stores for fill_span(), four or eight pixels at a time */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FILL_LANES          8
+typedef __m256i fill_lane_t;
+#define fill_set1(c)        _mm256_set1_epi32((int)(c))
+#define fill_store(p, v)    _mm256_storeu_si256((__m256i *)(p), v)
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FILL_LANES          4
+typedef __m128i fill_lane_t;
+#define fill_set1(c)        _mm_set1_epi32((int)(c))
+#define fill_store(p, v)    _mm_storeu_si128((__m128i *)(p), v)
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FILL_LANES          4
+typedef uint32x4_t fill_lane_t;
+#define fill_set1(c)        vdupq_n_u32(c)
+#define fill_store(p, v)    vst1q_u32((uint32_t *)(p), v)
+#endif
+
+/* Sets n pixels from p on. */
+static void fill_span(unsigned *p, int n, unsigned color)
+{
+#ifdef FILL_LANES
+   fill_lane_t v = fill_set1(color);
+
+   for (; n >= FILL_LANES * 2; n -= FILL_LANES * 2, p += FILL_LANES * 2)
+   {
+      fill_store(p, v);
+      fill_store(p + FILL_LANES, v);
+   }
+   for (; n >= FILL_LANES; n -= FILL_LANES, p += FILL_LANES)
+      fill_store(p, v);
+#endif
+
+   while (n-- > 0)
+      *p++ = color;
+}
+
 void DrawFBoxBmp(char  *buffer,int x,int y,int dx,int dy,unsigned color)
 {
-   int i,j,idx;
+   int j;
 
 #if defined PITCH && PITCH == 4
    unsigned *mbuffer=(unsigned*)buffer;
+
+   /* a row at a time, along memory */
+   for(j = y; j < y + dy; j++)
+      fill_span(mbuffer + x + j * VIRTUAL_WIDTH, dx, color);
 #else
+   int i;
    unsigned short *mbuffer=(unsigned short *)buffer;
+
+   for(j = y; j < y + dy; j++)
+   {
+      for(i = x; i < x + dx; i++)
+         mbuffer[i + j * VIRTUAL_WIDTH] = color;
+   }
 #endif
+}
+
+#include "noncairo/font2.c"
+
+/* Draw_string() only writes inside this rectangle */
+static int clip_x0, clip_y0, clip_x1, clip_y1;
+
+/* Set pixels of every glyph row as runs of (start, length) at scale 1,
+ * taken from font_array once. A scaled run is one span per pixel row,
+ * so drawing needs no buffer and no bit tests. */
+#define GLYPH_MAX_RUNS 4
 
-   for(i = x; i < x + dx; i++)
+static unsigned char glyph_runs[256][8][GLYPH_MAX_RUNS][2];
+static unsigned char glyph_run_count[256][8];
+static bool glyphs_ready = false;
+
+static void init_glyphs(void)
+{
+   int c, row, bit;
+
+   if (glyphs_ready)
+      return;
+
+   for (c = 0; c < 256; c++)
    {
-      for(j = y; j < y + dy; j++)
+      for (row = 0; row < 8; row++)
       {
-         idx= i + j * VIRTUAL_WIDTH;
-         mbuffer[idx] = color;	
+         unsigned char b = font_array[(c ^ 0x80) * 8 + row];
+         int n = 0;
+
+         /* seven columns, a run can only start after a gap */
+         for (bit = 0; bit < 7; bit++)
+         {
+            if (!(b & (1 << (7 - bit))))
+               continue;
+
+            if (n && glyph_runs[c][row][n - 1][0] + glyph_runs[c][row][n - 1][1] == bit)
+               glyph_runs[c][row][n - 1][1]++;
+            else
+            {
+               glyph_runs[c][row][n][0] = (unsigned char)bit;
+               glyph_runs[c][row][n][1] = 1;
+               n++;
+            }
+         }
+
+         glyph_run_count[c][row] = (unsigned char)n;
       }
    }
 
+   glyphs_ready = true;
 }
 
-#include "noncairo/font2.c"
-
-void Draw_string(char *surf, signed short int x, signed short int y, const unsigned char *string,unsigned short maxstrlen,unsigned short xscale, unsigned short yscale, unsigned  fg, unsigned  bg)
+static void fill_span_clipped(unsigned *mbuffer, int x0, int x1, int y, unsigned color)
 {
-   int strlen, surfw, surfh;
-   unsigned char *linesurf;
-   signed  int ypixel;
-   unsigned  *yptr; 
-   int col, bit;
-   unsigned char b;
+   if (y < clip_y0 || y >= clip_y1)
+      return;
+   if (x0 < clip_x0)
+      x0 = clip_x0;
+   if (x1 > clip_x1)
+      x1 = clip_x1;
 
-   int xrepeat, yrepeat;
+   fill_span(mbuffer + y * VIRTUAL_WIDTH + x0, x1 - x0, color);
+}
 
-#if defined PITCH && PITCH == 4
+void Draw_string(char *surf, signed short int x, signed short int y, const unsigned char *string,unsigned short maxstrlen,unsigned short xscale, unsigned short yscale, unsigned  fg, unsigned  bg)
+{
+   int strlen, col, row, run, yrepeat;
    unsigned *mbuffer=(unsigned*)surf;
-#else
-   unsigned short *mbuffer=(unsigned short *)surf;
-#endif
 
    if(string == NULL)
       return;
    for(strlen = 0; strlen<maxstrlen && string[strlen]; strlen++)
    {}
 
-   surfw=strlen * 7 * xscale;
-   surfh=8 * yscale;
-
-#if defined PITCH && PITCH == 4	
+   /* pixels of colour 0 are left alone */
+   if (bg)
+      for (yrepeat = y; yrepeat < y + 8 * yscale; yrepeat++)
+         fill_span_clipped(mbuffer, x, x + strlen * 7 * xscale, yrepeat, bg);
 
-   linesurf = malloc(sizeof(unsigned ) * surfw * surfh);
-   yptr = (unsigned *)&linesurf[0];
-#else 
-   linesurf = malloc(sizeof(unsigned short)* surfw * surfh);
-   yptr = (unsigned short *)&linesurf[0];
-#endif
+   if (!fg)
+      return;
 
-   for(ypixel = 0; ypixel < 8; ypixel++)
+   for (col = 0; col < strlen; col++)
    {
-      for(col=0; col<strlen; col++)
+      int gx = x + col * 7 * xscale;
+
+      for (row = 0; row < 8; row++)
       {
-         b = font_array[(string[col]^0x80)*8 + ypixel];
+         const unsigned char (*runs)[2] = glyph_runs[string[col]][row];
 
-         for(bit=0; bit<7; bit++, yptr++)
-         {              
-            *yptr = (b & (1<<(7-bit))) ? fg : bg;
-            for(xrepeat = 1; xrepeat < xscale; xrepeat++, yptr++)
-               yptr[1] = *yptr;
+         for (run = 0; run < glyph_run_count[string[col]][row]; run++)
+         {
+            int x0 = gx + runs[run][0] * xscale;
+            int x1 = x0 + runs[run][1] * xscale;
+
+            for (yrepeat = 0; yrepeat < yscale; yrepeat++)
+               fill_span_clipped(mbuffer, x0, x1, y + row * yscale + yrepeat, fg);
          }
       }
-
-      for(yrepeat = 1; yrepeat < yscale; yrepeat++) 
-         for(xrepeat = 0; xrepeat<surfw; xrepeat++, yptr++)
-            *yptr = yptr[-surfw];
-
    }
-
-#if defined PITCH && PITCH == 4	
-   yptr = (unsigned *)&linesurf[0];
-#else 
-   yptr = (unsigned short*)&linesurf[0];
-#endif
-
-   for(yrepeat = y; yrepeat < y+ surfh; yrepeat++) 
-      for(xrepeat = x; xrepeat< x+surfw; xrepeat++,yptr++)
-         if(*yptr!=0)
-            mbuffer[xrepeat+yrepeat*VIRTUAL_WIDTH] = *yptr;
-
-   free(linesurf);
 }
 
 void Draw_text(char *buffer,int x,int y,unsigned    fgcol,unsigned   int bgcol ,int scalex,int scaley , int max,const char *string,...)
@@ -178,30 +247,402 @@ static void set_rgba(int ctx, int r, int g, int b, float a)
    nullctx.color=RGB32(r,g,b,(int)a*255);
 }
 
+/* Damage tracking. The drawing functions below only record what they
+ * would draw; game_render() then splits the screen into blocks, hashes
+ * the items touching each block in drawing order and draws again only
+ * the blocks whose hash changed since the last frame, clipped to them.
+ * A screen at rest costs the hashing and no pixels. */
+
+#define DAMAGE_BLOCK      16
+#define DAMAGE_COLS       (((SCREEN_WIDTH) + DAMAGE_BLOCK - 1) / DAMAGE_BLOCK)
+#define DAMAGE_ROWS       (((SCREEN_HEIGHT) + DAMAGE_BLOCK - 1) / DAMAGE_BLOCK)
+
+/* an 8x8 board with every tile moving and the pause overlay stays
+ * well below these */
+#define DRAW_MAX_ITEMS    1024
+#define DRAW_TEXT_POOL    16384
+
+enum
+{
+   ITEM_FILL = 0,
+   ITEM_TEXT,
+   /* a copy from static_buf */
+   ITEM_STATIC,
+   /* a copy of the tile sprite for the exponent in color */
+   ITEM_SPRITE
+};
+
+typedef struct
+{
+   int kind;
+   /* bounds on screen */
+   int x, y, w, h;
+   unsigned color;
+   int xscale, yscale;
+   /* ITEM_TEXT: characters in text_pool */
+   int text, len;
+} draw_item_t;
+
+static draw_item_t items[DRAW_MAX_ITEMS];
+static int item_count;
+static char text_pool[DRAW_TEXT_POOL];
+static int text_used;
+
+/* DAMAGE_ROWS * DAMAGE_COLS each, allocated with the frame as SPACING
+ * is no constant expression */
+static uint64_t *block_hash;
+static uint64_t *drawn_hash;
+/* five rows of DAMAGE_COLS for the rectangles */
+static int *damage_runs;
+
+/* Background, panels and empty cells, drawn once per theme at the
+ * screen size with no padding. static_generation goes into the hash of
+ * its item, so a new layer damages the whole screen. */
+static unsigned *static_buf;
+static bool static_dark_theme;
+static unsigned static_generation;
+
+/* Resting tiles, fill and label composed once per exponent and theme
+ * at TILE_SIZE. A tile whose label would stick out of it is left to
+ * the fill and text items, marked -1 in tile_sprite_state. */
+static unsigned *tile_sprite[MAX_TILE_EXPONENT + 1];
+static signed char tile_sprite_state[MAX_TILE_EXPONENT + 1];
+static bool sprite_dark_theme;
+static unsigned sprite_generation;
+
+/* the next frame is drawn in full */
+static bool damage_all = true;
+
+static draw_item_t *add_item(int kind, int x, int y, int w, int h)
+{
+   draw_item_t *item;
+
+   if (item_count == DRAW_MAX_ITEMS || w <= 0 || h <= 0)
+      return NULL;
+
+   item         = &items[item_count++];
+   item->kind   = kind;
+   item->x      = x;
+   item->y      = y;
+   item->w      = w;
+   item->h      = h;
+   item->color  = nullctx.color;
+   item->xscale = 0;
+   item->yscale = 0;
+   item->text   = 0;
+   item->len    = 0;
+   return item;
+}
+
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t size)
+{
+   const unsigned char *p = (const unsigned char *)data;
+
+   /* FNV-1a */
+   while (size--)
+      h = (h ^ *p++) * 0x100000001b3ull;
+
+   return h;
+}
+
+static uint64_t hash_item(const draw_item_t *item)
+{
+   int fields[8];
+   uint64_t h = 0xcbf29ce484222325ull;
+
+   fields[0] = item->kind;
+   fields[1] = item->x;
+   fields[2] = item->y;
+   fields[3] = item->w;
+   fields[4] = item->h;
+   fields[5] = (int)item->color;
+   fields[6] = item->xscale;
+   fields[7] = item->yscale;
+
+   h = hash_bytes(h, fields, sizeof(fields));
+   return hash_bytes(h, text_pool + item->text, item->len);
+}
+
+/* Copies the part of a stored picture of 'item' that is in
+ * [x0, x1) x [y0, y1). */
+static void blit_item(const draw_item_t *item, const unsigned *src, int stride,
+      int x0, int y0, int x1, int y1)
+{
+   int y;
+
+   src += (y0 - item->y) * stride + (x0 - item->x);
+
+   for (y = y0; y < y1; y++, src += stride)
+      memcpy(frame_buf + y * VIRTUAL_WIDTH + x0, src, (x1 - x0) * sizeof(*frame_buf));
+}
+
+static void draw_item(const draw_item_t *item)
+{
+   int x0 = item->x > clip_x0 ? item->x : clip_x0;
+   int y0 = item->y > clip_y0 ? item->y : clip_y0;
+   int x1 = item->x + item->w < clip_x1 ? item->x + item->w : clip_x1;
+   int y1 = item->y + item->h < clip_y1 ? item->y + item->h : clip_y1;
+
+   if (x0 >= x1 || y0 >= y1)
+      return;
+
+   if (item->kind == ITEM_FILL)
+      DrawFBoxBmp((char*)frame_buf, x0, y0, x1 - x0, y1 - y0, item->color);
+   else if (item->kind == ITEM_STATIC)
+      blit_item(item, static_buf, SCREEN_WIDTH, x0, y0, x1, y1);
+   else if (item->kind == ITEM_SPRITE)
+      blit_item(item, tile_sprite[item->color], TILE_SIZE, x0, y0, x1, y1);
+   else
+      Draw_string((char*)frame_buf, item->x, item->y,
+            (const unsigned char*)text_pool + item->text, item->len,
+            item->xscale, item->yscale, item->color, 0);
+}
+
+static void damage_begin(void)
+{
+   item_count = 0;
+   text_used  = 0;
+}
+
+/* Draws every item touching the blocks in [bx0, bx1) x [by0, by1). */
+static void damage_repaint(int bx0, int by0, int bx1, int by1)
+{
+   int i;
+
+   clip_x0 = bx0 * DAMAGE_BLOCK;
+   clip_y0 = by0 * DAMAGE_BLOCK;
+   clip_x1 = bx1 * DAMAGE_BLOCK < (SCREEN_WIDTH) ? bx1 * DAMAGE_BLOCK : (SCREEN_WIDTH);
+   clip_y1 = by1 * DAMAGE_BLOCK < (SCREEN_HEIGHT) ? by1 * DAMAGE_BLOCK : (SCREEN_HEIGHT);
+
+   for (i = 0; i < item_count; i++)
+      draw_item(&items[i]);
+}
+
+static void damage_end(void)
+{
+   int i, bx, by;
+   /* runs of damaged blocks still open from the rows above */
+   int *open_x0   = damage_runs;
+   int *open_x1   = damage_runs + DAMAGE_COLS;
+   int *open_y    = damage_runs + DAMAGE_COLS * 2;
+   int *run_x0    = damage_runs + DAMAGE_COLS * 3;
+   int *run_x1    = damage_runs + DAMAGE_COLS * 4;
+   int open_count = 0;
+
+   if (!block_hash || !drawn_hash || !damage_runs)
+   {
+      damage_repaint(0, 0, DAMAGE_COLS, DAMAGE_ROWS);
+      return;
+   }
+
+   for (i = 0; i < DAMAGE_ROWS * DAMAGE_COLS; i++)
+      block_hash[i] = 0;
+
+   for (i = 0; i < item_count; i++)
+   {
+      const draw_item_t *item = &items[i];
+      uint64_t h = hash_item(item);
+      int cx0    = item->x < 0 ? 0 : item->x / DAMAGE_BLOCK;
+      int cy0    = item->y < 0 ? 0 : item->y / DAMAGE_BLOCK;
+      int cx1    = (item->x + item->w - 1) / DAMAGE_BLOCK;
+      int cy1    = (item->y + item->h - 1) / DAMAGE_BLOCK;
+
+      if (cx1 >= DAMAGE_COLS)
+         cx1 = DAMAGE_COLS - 1;
+      if (cy1 >= DAMAGE_ROWS)
+         cy1 = DAMAGE_ROWS - 1;
+
+      for (by = cy0; by <= cy1; by++)
+         for (bx = cx0; bx <= cx1; bx++)
+            block_hash[by * DAMAGE_COLS + bx] =
+               (block_hash[by * DAMAGE_COLS + bx] ^ h) * 0x9e3779b97f4a7c15ull;
+   }
+
+   /* Damaged blocks go out as rectangles: runs along a row, grown
+    * downwards while the next row has the same run. */
+   for (by = 0; by <= DAMAGE_ROWS; by++)
+   {
+      int runs = 0, kept = 0;
+
+      for (bx = 0; by < DAMAGE_ROWS && bx < DAMAGE_COLS; bx++)
+      {
+         int b = by * DAMAGE_COLS + bx;
+
+         if (!damage_all && block_hash[b] == drawn_hash[b])
+            continue;
+
+         if (runs && run_x1[runs - 1] == bx)
+            run_x1[runs - 1] = bx + 1;
+         else
+         {
+            run_x0[runs] = bx;
+            run_x1[runs] = bx + 1;
+            runs++;
+         }
+      }
+
+      /* close what does not carry on, keep what does */
+      for (i = 0; i < open_count; i++)
+      {
+         int j;
+
+         for (j = 0; j < runs; j++)
+            if (run_x0[j] == open_x0[i] && run_x1[j] == open_x1[i])
+               break;
+
+         if (j < runs)
+         {
+            run_x0[j] = -1;
+            open_x0[kept] = open_x0[i];
+            open_x1[kept] = open_x1[i];
+            open_y[kept]  = open_y[i];
+            kept++;
+         }
+         else
+            damage_repaint(open_x0[i], open_y[i], open_x1[i], by);
+      }
+
+      open_count = kept;
+
+      for (i = 0; i < runs; i++)
+      {
+         if (run_x0[i] < 0)
+            continue;
+
+         open_x0[open_count] = run_x0[i];
+         open_x1[open_count] = run_x1[i];
+         open_y[open_count]  = by;
+         open_count++;
+      }
+   }
+
+   memcpy(drawn_hash, block_hash, DAMAGE_ROWS * DAMAGE_COLS * sizeof(*drawn_hash));
+   damage_all = false;
+}
+
 static void fill_rectangle(int ctx, int x, int y, int w, int h)
 {
-   char *ptr=(char*)frame_buf;
-   DrawFBoxBmp(ptr, x, y, w, h, nullctx.color);
+   add_item(ITEM_FILL, x, y, w, h);
 }
 
 static void draw_text_centered(int ctx, const char *utf8, int x, int y, int w, int h)
 {
-
-   char *ptr=(char*)frame_buf;
    int size=strlen(utf8);
    int foy=h?(8*nullctx.fontsize_y)/2 + h/2:8*nullctx.fontsize_y;
    int fox=w?w/2 -(size*7*nullctx.fontsize_y)/2:0;
+   draw_item_t *item;
+
+   if (text_used + size > DRAW_TEXT_POOL)
+      return;
 
-   Draw_text(ptr,x+fox,y+foy,nullctx.color,0 ,nullctx.fontsize_x,nullctx.fontsize_y ,size, utf8);
+   item = add_item(ITEM_TEXT, x + fox, y + foy,
+         size * 7 * nullctx.fontsize_x, 8 * nullctx.fontsize_y);
+   if (!item)
+      return;
+
+   item->xscale = nullctx.fontsize_x;
+   item->yscale = nullctx.fontsize_y;
+   item->text   = text_used;
+   item->len    = size;
 
+   memcpy(text_pool + text_used, utf8, size);
+   text_used += size;
 }
 
-static void draw_tile(int ctx, cell_t *cell)
+/* Fill and label of a tile, the items a sprite is made of. */
+static void add_tile_items(int ctx, int value, int x, int y, int w, int h)
+{
+   if (value)
+      nullctx.color= dark_theme ? color_lut_dark[value] : color_lut[value];
+   else
+      nullctx.color= dark_theme ? RGB32(50,63,75,255) : RGB32(205,192,180,255);
+
+   fill_rectangle(ctx, x, y, w, h);
+
+   if (value)
+   {
+      int label_len = strlen(label_lut[value]);
+      nullctx_fontsize(label_len <= 3 ? 3 : 2);
+
+      if (dark_theme)
+         set_rgb(ctx, 200, 200, 200);
+      else
+         set_rgb(ctx, 119, 110, 101);
+      draw_text_centered(ctx, label_lut[value], x, y, w, h);
+   }
+}
+
+/* Makes sure tile_sprite[value] holds the tile for the current theme.
+ * The items are recorded as for a tile at 0,0, drawn into the sprite
+ * and dropped from the frame again. */
+static bool tile_sprite_ready(int ctx, int value)
+{
+   unsigned *target = frame_buf;
+   int stride       = VIRTUAL_WIDTH;
+   int first_item   = item_count;
+   int first_text   = text_used;
+   int i;
+
+   if (sprite_dark_theme != dark_theme)
+   {
+      memset(tile_sprite_state, 0, sizeof(tile_sprite_state));
+      sprite_dark_theme = dark_theme;
+      sprite_generation++;
+   }
+
+   if (tile_sprite_state[value])
+      return tile_sprite_state[value] > 0;
+
+   if (!tile_sprite[value])
+      tile_sprite[value] = (unsigned*)malloc(TILE_SIZE * TILE_SIZE * sizeof(*tile_sprite[value]));
+
+   if (!tile_sprite[value])
+      return false;
+
+   add_tile_items(ctx, value, 0, 0, TILE_SIZE, TILE_SIZE);
+
+   /* the frame is out of items, try again next frame */
+   if (item_count != first_item + 2)
+   {
+      item_count = first_item;
+      text_used  = first_text;
+      return false;
+   }
+
+   tile_sprite_state[value] = 1;
+
+   for (i = first_item; i < item_count; i++)
+      if (items[i].x < 0 || items[i].y < 0 ||
+          items[i].x + items[i].w > TILE_SIZE || items[i].y + items[i].h > TILE_SIZE)
+         tile_sprite_state[value] = -1;
+
+   if (tile_sprite_state[value] > 0)
+   {
+      frame_buf     = tile_sprite[value];
+      VIRTUAL_WIDTH = TILE_SIZE;
+      clip_x0       = 0;
+      clip_y0       = 0;
+      clip_x1       = TILE_SIZE;
+      clip_y1       = TILE_SIZE;
+
+      for (i = first_item; i < item_count; i++)
+         draw_item(&items[i]);
+
+      frame_buf     = target;
+      VIRTUAL_WIDTH = stride;
+   }
+
+   item_count = first_item;
+   text_used  = first_text;
+
+   return tile_sprite_state[value] > 0;
+}
+
+static void draw_tile(int ctx, const cell_t *cell)
 {
    int x, y;
    int w = TILE_SIZE, h = TILE_SIZE;
    int font_size = FONT_SIZE;
-   float *frame_time = game_get_frame_time();
 
    (void)font_size;
 
@@ -217,8 +658,6 @@ static void draw_tile(int ctx, cell_t *cell)
 
       if (cell->move_time < 0.5 && cell->source)
          draw_tile(ctx, cell->source);
-
-      cell->move_time += *frame_time * TILE_ANIM_SPEED;
    }
    else if (cell->appear_time < 1)
    {
@@ -234,29 +673,72 @@ static void draw_tile(int ctx, cell_t *cell)
 
       x += TILE_SIZE/2 - w/2;
       y += TILE_SIZE/2 - h/2;
-
-      cell->appear_time += *frame_time * TILE_ANIM_SPEED;
    } else {
       grid_to_screen(cell->pos, &x, &y);
    }
 
-   if (cell->value)
-      nullctx.color= dark_theme ? color_lut_dark[cell->value] : color_lut[cell->value];
-   else
-      nullctx.color= dark_theme ? RGB32(50,63,75,255) : RGB32(205,192,180,255);
+   if (cell->value && w == TILE_SIZE && h == TILE_SIZE && tile_sprite_ready(ctx, cell->value))
+   {
+      draw_item_t *item = add_item(ITEM_SPRITE, x, y, w, h);
 
-   fill_rectangle(ctx, x, y, w, h);
+      if (item)
+      {
+         item->color  = cell->value;
+         item->xscale = sprite_generation;
+      }
+      return;
+   }
+
+   add_tile_items(ctx, cell->value, x, y, w, h);
+}
+
+/* Rectangle in arrow space, u along the arrow from its center and v
+ * across it. */
+static void fill_arrow_rect(int ctx, direction_t dir, int u0, int u1, int v0, int v1)
+{
+   int cx = (SCREEN_WIDTH) / 2;
+   int cy = BOARD_OFFSET_Y + BOARD_HEIGHT / 2;
 
-   if (cell->value)
+   switch (dir)
    {
-      int label_len = strlen(label_lut[cell->value]);
-      nullctx_fontsize(label_len <= 3 ? 3 : 2);
+      case DIR_UP:
+         fill_rectangle(ctx, cx + v0, cy - u1, v1 - v0, u1 - u0);
+         break;
+      case DIR_DOWN:
+         fill_rectangle(ctx, cx + v0, cy + u0, v1 - v0, u1 - u0);
+         break;
+      case DIR_LEFT:
+         fill_rectangle(ctx, cx - u1, cy + v0, u1 - u0, v1 - v0);
+         break;
+      case DIR_RIGHT:
+         fill_rectangle(ctx, cx + u0, cy + v0, u1 - u0, v1 - v0);
+         break;
+      default:
+         break;
+   }
+}
 
-      if (dark_theme)
-         set_rgb(ctx, 200, 200, 200);
-      else
-         set_rgb(ctx, 119, 110, 101);
-      draw_text_centered(ctx, label_lut[cell->value], x, y, w, h);
+/* hint arrow over the middle of the board, the head in 2px steps */
+static void draw_hint(int ctx)
+{
+   int u;
+   int half        = TILE_SIZE * 3 / 8;
+   direction_t dir = game_get_hint();
+
+   if (dir == DIR_NONE)
+      return;
+
+   if (dark_theme)
+      set_rgb(ctx, 200, 200, 200);
+   else
+      set_rgb(ctx, 119, 110, 101);
+
+   fill_arrow_rect(ctx, dir, -half, 0, -half / 4, half / 4);
+
+   for (u = 0; u < half; u += 2)
+   {
+      int w = half * 3 / 4 * (half - u) / half;
+      fill_arrow_rect(ctx, dir, u, u + 2, -w, w);
    }
 }
 
@@ -267,6 +749,8 @@ void game_calculate_pitch(void)
 
 static void init_luts(void)
 {
+   int i;
+
    color_lut_dark[0] = RGB32(17,27,37,90);
    color_lut_dark[1] = RGB32(17,27,37,255);
 
@@ -310,6 +794,16 @@ static void init_luts(void)
    color_lut[15] = RGB32(79, 200,28,255);
    color_lut[16] = RGB32(62, 197,24,255);
    color_lut[17] = RGB32(46, 194,20,255);
+
+   /* 262144 and up share the last colors */
+   for (i = 18; i <= MAX_TILE_EXPONENT; i++)
+   {
+      color_lut[i]      = color_lut[17];
+      color_lut_dark[i] = color_lut_dark[17];
+   }
+
+   for (i = 0; i <= MAX_TILE_EXPONENT; i++)
+      format_tile_label(label_lut[i], sizeof(label_lut[i]), i);
 }
 
 static void init_static_surface(void)
@@ -338,14 +832,14 @@ static void init_static_surface(void)
       set_rgb(static_ctx, 70, 83, 96);
    else
       set_rgb(static_ctx, 185, 172, 159);
-   fill_rectangle(static_ctx, SPACING, SPACING, TILE_SIZE*2+SPACING*2, TILE_SIZE);
+   fill_rectangle(static_ctx, SPACING, SPACING, PANEL_WIDTH, TILE_SIZE);
 
    /* best bg */
    if (dark_theme)
       set_rgb(static_ctx, 70, 83, 96);
    else
       set_rgb(static_ctx, 185, 172, 159);
-   fill_rectangle(static_ctx, TILE_SIZE*2+SPACING*4, SPACING, TILE_SIZE*2+SPACING*2, TILE_SIZE);
+   fill_rectangle(static_ctx, BEST_OFFSET_X, SPACING, PANEL_WIDTH, TILE_SIZE);
 
    nullctx.color = dark_theme ? color_lut_dark[1] : color_lut[1];
    nullctx_fontsize(1) ;
@@ -354,7 +848,7 @@ static void init_static_surface(void)
    draw_text_centered(static_ctx, "SCORE", SPACING*2, SPACING * 2, 0, 0);
 
    /* best title */
-   draw_text_centered(static_ctx, "BEST", TILE_SIZE*2+SPACING*5, SPACING*2, 0, 0);
+   draw_text_centered(static_ctx, "BEST", BEST_OFFSET_X + SPACING, SPACING*2, 0, 0);
 
    /* draw background cells */
    dummy.move_time   = 1;
@@ -362,9 +856,9 @@ static void init_static_surface(void)
    dummy.source      = NULL;
    dummy.value       = 0;
 
-   for (row = 0; row < 4; row++)
+   for (row = 0; row < GRID_HEIGHT; row++)
    {
-      for (col = 0; col < 4; col++)
+      for (col = 0; col < GRID_WIDTH; col++)
       {
          dummy.pos.x = col;
          dummy.pos.y = row;
@@ -375,17 +869,58 @@ static void init_static_surface(void)
 
 }
 
+/* Draws the static layer into static_buf when there is none for the
+ * current theme, then starts the frame with a copy of it. */
+static void draw_static_layer(void)
+{
+   unsigned *target = frame_buf;
+   int stride       = VIRTUAL_WIDTH;
+   draw_item_t *item;
+
+   if (!static_buf || static_dark_theme != dark_theme)
+   {
+      if (!static_buf)
+         static_buf = (unsigned*)malloc((SCREEN_WIDTH) * (SCREEN_HEIGHT) * sizeof(*static_buf));
+
+      /* without memory the layer is drawn with the frame */
+      if (!static_buf)
+      {
+         init_static_surface();
+         return;
+      }
+
+      frame_buf     = static_buf;
+      VIRTUAL_WIDTH = SCREEN_WIDTH;
+
+      damage_begin();
+      init_static_surface();
+      damage_repaint(0, 0, DAMAGE_COLS, DAMAGE_ROWS);
+      damage_begin();
+
+      frame_buf     = target;
+      VIRTUAL_WIDTH = stride;
+
+      static_dark_theme = dark_theme;
+      static_generation++;
+   }
+
+   if ((item = add_item(ITEM_STATIC, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT)))
+      item->color = static_generation;
+}
+
 void game_init(void)
 {
-   unsigned int t = (unsigned int)time(NULL);
    frame_buf = calloc(SCREEN_HEIGHT, SCREEN_PITCH);
 
-   srand(t);
+   block_hash  = (uint64_t*)calloc(DAMAGE_ROWS * DAMAGE_COLS, sizeof(*block_hash));
+   drawn_hash  = (uint64_t*)calloc(DAMAGE_ROWS * DAMAGE_COLS, sizeof(*drawn_hash));
+   damage_runs = (int*)calloc(DAMAGE_COLS * 5, sizeof(*damage_runs));
+   damage_all  = true;
 
    initgraph();
 
    init_luts();
-   init_static_surface();
+   init_glyphs();
 
    init_game();
    start_game();
@@ -393,19 +928,40 @@ void game_init(void)
 
 void game_deinit(void)
 {
-   if (frame_buf && !libretro_supports_sw_fb)
-      free(frame_buf);
+   int i;
+
+   deinit_game();
+
+   free(frame_buf);
    frame_buf = NULL;
+
+   free(block_hash);
+   free(drawn_hash);
+   free(damage_runs);
+   free(static_buf);
+   for (i = 0; i <= MAX_TILE_EXPONENT; i++)
+   {
+      free(tile_sprite[i]);
+      tile_sprite[i]       = NULL;
+      tile_sprite_state[i] = 0;
+   }
+   block_hash  = NULL;
+   drawn_hash  = NULL;
+   damage_runs = NULL;
+   static_buf  = NULL;
 }
 
 void render_playing(void)
 {
-   int *delta_score;
-   float *delta_score_time;
+   float delta_score_time;
    int row, col, ctx=0;
-   char tmp[10] = {0};
+   char tmp[20] = {0};
+   const cell_t *grid;
    float *frame_time = game_get_frame_time();
 
+   anim_sync(game_get_board());
+   grid = anim_cells();
+
    /* paint static background */
 
    nullctx_fontsize(2) ;
@@ -415,49 +971,47 @@ void render_playing(void)
       set_rgb(ctx, 0, 0, 0);
    else
       set_rgb(ctx, 255, 255, 255);
-   sprintf(tmp, "%i", game_get_score() % 1000000);
-   draw_text_centered(ctx, tmp, SPACING*2, SPACING * 5, TILE_SIZE*2, 0);
+   draw_text_centered(ctx, number_text(&score_text, game_get_score(), 6), SPACING*2, SPACING * 5, PANEL_WIDTH - SPACING*2, 0);
 
-   sprintf(tmp, "%i", game_get_best_score() % 1000000);
    nullctx.color = dark_theme ? color_lut_dark[1] : color_lut[1];
 
-   draw_text_centered(ctx, tmp, TILE_SIZE*2+SPACING*5, SPACING * 5, TILE_SIZE*2, 0);
+   draw_text_centered(ctx, number_text(&best_text, game_get_best_score(), 6), BEST_OFFSET_X + SPACING, SPACING * 5, PANEL_WIDTH - SPACING*2, 0);
 
-   for (row = 0; row < 4; row++)
+   for (row = 0; row < GRID_HEIGHT; row++)
    {
-      for (col = 0; col < 4; col++)
+      for (col = 0; col < GRID_WIDTH; col++)
       {
-         cell_t *grid = game_get_grid();
-         cell_t *cell = &grid[row * 4 + col];
+         const cell_t *cell = &grid[row * GRID_WIDTH + col];
 
          if (cell->value)
             draw_tile(ctx, cell);
       }
    }
 
-   delta_score_time = game_get_delta_score_time();
-   delta_score = game_get_delta_score();
+   draw_hint(ctx);
+
+   delta_score_time = anim_delta_score_time();
 
    /* draw +score animation */
-   if (*delta_score_time < 1)
+   if (delta_score_time < 1)
    {
       int x, y;
 
       nullctx_fontsize(1);
       x = SPACING * 2;
       y = SPACING * 5;
-      y = lerp(y, y - TILE_SIZE, *delta_score_time);
+      y = lerp(y, y - TILE_SIZE, delta_score_time);
 
       if (dark_theme)
-         set_rgba(ctx, 136, 145, 154, lerp(1, 0, *delta_score_time));
+         set_rgba(ctx, 136, 145, 154, lerp(1, 0, delta_score_time));
       else
-         set_rgba(ctx, 119, 110, 101, lerp(1, 0, *delta_score_time));
+         set_rgba(ctx, 119, 110, 101, lerp(1, 0, delta_score_time));
 
-      sprintf(tmp, "+%i", *delta_score);
+      sprintf(tmp, "+%s", number_text(&delta_text, anim_delta_score(), 6));
       draw_text_centered(ctx, tmp, x, y, TILE_SIZE * 2, TILE_SIZE);
-
-      *delta_score_time += *frame_time;
    }
+
+   anim_advance(*frame_time);
 }
 
 void render_title(void)
@@ -483,12 +1037,12 @@ void render_title(void)
       set_rgb(ctx, 70, 83, 96);
    else
       set_rgb(ctx, 185, 172, 159);
-   fill_rectangle(ctx, TILE_SIZE / 2, TILE_SIZE * 4, SCREEN_HEIGHT - TILE_SIZE * 2, FONT_SIZE * 3);
+   fill_rectangle(ctx, TILE_SIZE / 2, MESSAGE_OFFSET_Y, SCREEN_HEIGHT - TILE_SIZE * 2, FONT_SIZE * 3);
 
    nullctx_fontsize(1);
    nullctx.color = dark_theme ? color_lut_dark[1] : color_lut[1];
 
-   draw_text_centered(ctx, "PRESS START", TILE_SIZE / 2 + SPACING, TILE_SIZE * 4 + SPACING,
+   draw_text_centered(ctx, "PRESS START", TILE_SIZE / 2 + SPACING, MESSAGE_OFFSET_Y + SPACING,
                       SCREEN_HEIGHT - TILE_SIZE * 2 - SPACING * 2, FONT_SIZE * 3 - SPACING * 2);
 
 }
@@ -523,7 +1077,7 @@ void render_win_or_game_over(void)
    else
       set_rgb(ctx, 185, 172, 159);
 
-   sprintf(tmp, "Score: %i", game_get_score());
+   sprintf(tmp, "Score: %s", number_text(&total_text, game_get_score(), 12));
    draw_text_centered(ctx, tmp, 0, 0, SCREEN_WIDTH, TILE_SIZE*5);
 
    if (state == STATE_WON)
@@ -531,7 +1085,7 @@ void render_win_or_game_over(void)
       int bw = SCREEN_HEIGHT - TILE_SIZE * 2;
       int bh = FONT_SIZE * 3;
       int bx = TILE_SIZE / 2;
-      int by = TILE_SIZE * 4;
+      int by = MESSAGE_OFFSET_Y;
 
       if (dark_theme)
          set_rgb(ctx, 70, 83, 96);
@@ -552,10 +1106,10 @@ void render_win_or_game_over(void)
          set_rgb(ctx, 70, 83, 96);
       else
          set_rgb(ctx, 185, 172, 159);
-      fill_rectangle(ctx, TILE_SIZE / 2, TILE_SIZE * 4, SCREEN_HEIGHT - TILE_SIZE * 2, FONT_SIZE * 3);
+      fill_rectangle(ctx, TILE_SIZE / 2, MESSAGE_OFFSET_Y, SCREEN_HEIGHT - TILE_SIZE * 2, FONT_SIZE * 3);
 
       nullctx.color = dark_theme ? color_lut_dark[1] : color_lut[1];
-      draw_text_centered(ctx, "PRESS START", TILE_SIZE / 2 + SPACING, TILE_SIZE * 4 + SPACING,
+      draw_text_centered(ctx, "PRESS START", TILE_SIZE / 2 + SPACING, MESSAGE_OFFSET_Y + SPACING,
                          SCREEN_HEIGHT - TILE_SIZE * 2 - SPACING * 2, FONT_SIZE * 3 - SPACING * 2);
    }
 }
@@ -564,6 +1118,7 @@ void render_paused(void)
 {
    char tmp[100];
    int ctx=0;
+   stats_t stats;
 
    render_playing();
 
@@ -574,6 +1129,9 @@ void render_paused(void)
       set_rgba(ctx, 250, 248, 239, 0.85);
    fill_rectangle(ctx, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
 
+   /* the overlay hides the board, keep its hint in view */
+   draw_hint(ctx);
+
    nullctx_fontsize(2); 
    if (dark_theme)
       set_rgb(ctx, 70, 83, 96);
@@ -587,20 +1145,38 @@ void render_paused(void)
    else
       set_rgb(ctx, 185, 172, 159);
 
-   sprintf(tmp, "Score: %i", game_get_score());
+   sprintf(tmp, "Score: %s", number_text(&total_text, game_get_score(), 12));
    draw_text_centered(ctx, tmp, 0, 0, SCREEN_WIDTH, TILE_SIZE*5);
 
+   /* where greedy play goes from here */
+   stats.rollouts = 0;
+   if (game_get_stats(&stats))
+   {
+      sprintf(tmp, "%s %.0f%%  %s %.0f%%  %s %.0f%%",
+            label_lut[stats.target[0]], stats.reach[0] * 100,
+            label_lut[stats.target[1]], stats.reach[1] * 100,
+            label_lut[stats.target[2]], stats.reach[2] * 100);
+      draw_text_centered(ctx, tmp, 0, 0, SCREEN_WIDTH, TILE_SIZE*5 + FONT_SIZE*5/4);
+      sprintf(tmp, "Greedy rollouts: score %.0f", stats.mean_score);
+      draw_text_centered(ctx, tmp, 0, 0, SCREEN_WIDTH, TILE_SIZE*5 + FONT_SIZE*5/2);
+   }
+   else if (stats.rollouts)
+   {
+      sprintf(tmp, "Rollouts %i/%i", stats.done, stats.rollouts);
+      draw_text_centered(ctx, tmp, 0, 0, SCREEN_WIDTH, TILE_SIZE*5 + FONT_SIZE*5/4);
+   }
+
    if (dark_theme)
       set_rgb(ctx, 70, 83, 96);
    else
       set_rgb(ctx, 185, 172, 159);
-   fill_rectangle(ctx, TILE_SIZE / 2, TILE_SIZE * 4, SCREEN_HEIGHT - TILE_SIZE * 2, FONT_SIZE * 5);
+   fill_rectangle(ctx, TILE_SIZE / 2, MESSAGE_OFFSET_Y, SCREEN_HEIGHT - TILE_SIZE * 2, FONT_SIZE * 5);
 
    nullctx.color= dark_theme ? color_lut_dark[1] : color_lut[1];
 
-   draw_text_centered(ctx, "SELECT: New Game", TILE_SIZE / 2 + SPACING, TILE_SIZE * 4 + SPACING,
+   draw_text_centered(ctx, "SELECT: New Game", TILE_SIZE / 2 + SPACING, MESSAGE_OFFSET_Y + SPACING,
                       SCREEN_HEIGHT - TILE_SIZE * 2 - SPACING * 2, FONT_SIZE * 3 - SPACING * 2);
-   draw_text_centered(ctx, "START: Continue", TILE_SIZE / 2 + SPACING, TILE_SIZE * 4 + SPACING + FONT_SIZE * 2,
+   draw_text_centered(ctx, "START: Continue", TILE_SIZE / 2 + SPACING, MESSAGE_OFFSET_Y + SPACING + FONT_SIZE * 2,
                       SCREEN_HEIGHT - TILE_SIZE * 2 - SPACING * 2, FONT_SIZE * 3 - SPACING * 2);
 }
 
@@ -638,6 +1214,15 @@ void game_render(void)
       libretro_sw_fb_checked = true;
    }
 
+   damage_begin();
+   draw_static_layer();
+
+   render_game();
+   damage_end();
+
+   /* A frontend buffer is only ours for this frame and may hold
+    * anything, so damage is tracked in frame_buf and the whole frame
+    * copied out. */
    if (libretro_supports_sw_fb)
    {
       struct retro_framebuffer fb = {0};
@@ -649,13 +1234,16 @@ void game_render(void)
       if (environ_cb(RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER, &fb)
             && fb.data)
       {
-         frame_buf = (unsigned *)fb.data;
-         SCREEN_PITCH = (int)fb.pitch;
+         int y;
+
+         for (y = 0; y < SCREEN_HEIGHT; y++)
+            memcpy((uint8_t *)fb.data + y * fb.pitch,
+                  (uint8_t *)frame_buf + y * SCREEN_PITCH, SCREEN_PITCH);
+
+         video_cb(fb.data, SCREEN_WIDTH, SCREEN_HEIGHT, fb.pitch);
+         return;
       }
    }
 
-   init_static_surface();
-
-   render_game();
    video_cb(frame_buf, SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_PITCH);
 }
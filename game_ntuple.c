@@ -0,0 +1,250 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <streams/file_stream.h>
+
+#include "game_ntuple.h"
+
+/* the header is part of the file format */
+typedef char ntuple_header_check[sizeof(ntuple_header_t) == NTUPLE_HEADER_SIZE ? 1 : -1];
+
+/* tuple cells as (x, y), a count of 0 ends the list */
+typedef struct
+{
+   int count;
+   uint8_t xy[NTUPLE_MAX_CELLS][2];
+} ntuple_pattern_t;
+
+#if GRID_DIM == 3
+/* two rows, a corner square and the middle cross */
+static const ntuple_pattern_t patterns[] = {
+   { 6, { {0, 0}, {1, 0}, {2, 0}, {0, 1}, {1, 1}, {2, 1} } },
+   { 4, { {0, 0}, {1, 0}, {0, 1}, {1, 1} } },
+   { 4, { {1, 0}, {0, 1}, {1, 1}, {2, 1} } },
+   { 0 }
+};
+#else
+/* the usual 4x4 set: an edge row with two cells below it, the same
+ * one row in, and the two 3x2 rectangles beside them. Larger boards
+ * sample it around their corners. */
+static const ntuple_pattern_t patterns[] = {
+   { 6, { {0, 0}, {1, 0}, {2, 0}, {3, 0}, {0, 1}, {1, 1} } },
+   { 6, { {0, 1}, {1, 1}, {2, 1}, {3, 1}, {0, 2}, {1, 2} } },
+   { 6, { {0, 0}, {1, 0}, {2, 0}, {0, 1}, {1, 1}, {2, 1} } },
+   { 6, { {0, 1}, {1, 1}, {2, 1}, {0, 2}, {1, 2}, {2, 2} } },
+   { 0 }
+};
+#endif
+
+/* Fills in the tuples of this board size, without any weights. */
+static void ntuple_setup(ntuple_t *net)
+{
+   int t, s, k;
+
+   memset(net, 0, sizeof(*net));
+   memset(net->header.cells, 0xff, sizeof(net->header.cells));
+
+   for (t = 0; patterns[t].count; t++)
+   {
+      net->count[t] = patterns[t].count;
+      net->size[t]  = (size_t)1 << (NTUPLE_VALUE_BITS * patterns[t].count);
+
+      for (k = 0; k < patterns[t].count; k++)
+      {
+         int x = patterns[t].xy[k][0];
+         int y = patterns[t].xy[k][1];
+
+         net->header.cells[t][k] = (uint8_t)(y * GRID_WIDTH + x);
+
+         /* rotations and reflections of a square board */
+         for (s = 0; s < NTUPLE_SYMMETRIES; s++)
+         {
+            int sx = s & 1 ? GRID_WIDTH - 1 - x : x;
+            int sy = s & 2 ? GRID_HEIGHT - 1 - y : y;
+
+            if (s & 4)
+            {
+               int tmp = sx;
+               sx      = sy;
+               sy      = tmp;
+            }
+
+            net->sym[t][s][k] = (uint8_t)(sy * GRID_WIDTH + sx);
+         }
+      }
+   }
+
+   net->tuples         = t;
+   net->header.magic   = NTUPLE_MAGIC;
+   net->header.version = NTUPLE_VERSION;
+   net->header.width   = GRID_WIDTH;
+   net->header.height  = GRID_HEIGHT;
+   net->header.tuples  = (uint8_t)t;
+}
+
+/* Points the tables into 'data' after checking the header. */
+static bool ntuple_attach(ntuple_t *net, const uint8_t *data, size_t size)
+{
+   int t;
+   size_t expected = NTUPLE_HEADER_SIZE;
+   const ntuple_header_t *header = (const ntuple_header_t *)data;
+
+   for (t = 0; t < net->tuples; t++)
+      expected += net->size[t] * sizeof(float);
+
+   if (size != expected ||
+       header->magic   != NTUPLE_MAGIC ||
+       header->version != NTUPLE_VERSION ||
+       header->width   != net->header.width ||
+       header->height  != net->header.height ||
+       header->tuples  != net->header.tuples ||
+       memcmp(header->cells, net->header.cells, sizeof(header->cells)))
+      return false;
+
+   net->header.games = header->games;
+   data             += NTUPLE_HEADER_SIZE;
+
+   for (t = 0; t < net->tuples; t++)
+   {
+      net->table[t] = (float *)data;
+      data         += net->size[t] * sizeof(float);
+   }
+
+   return true;
+}
+
+bool ntuple_alloc(ntuple_t *net)
+{
+   int t;
+   size_t size = NTUPLE_HEADER_SIZE;
+
+   ntuple_setup(net);
+
+   for (t = 0; t < net->tuples; t++)
+      size += net->size[t] * sizeof(float);
+
+   /* same layout as a file, header included */
+   if (!(net->heap = calloc(size, 1)))
+      return false;
+
+   memcpy(net->heap, &net->header, NTUPLE_HEADER_SIZE);
+   return ntuple_attach(net, (const uint8_t *)net->heap, size);
+}
+
+bool ntuple_load(ntuple_t *net, const char *path)
+{
+   void *buf   = NULL;
+   int64_t len = 0;
+
+   ntuple_setup(net);
+
+   if ((net->map = game_map_file(path)))
+   {
+      if (ntuple_attach(net, (const uint8_t *)game_map_data(net->map),
+               game_map_size(net->map)))
+         return true;
+   }
+   else if (filestream_read_file(path, &buf, &len) && buf)
+   {
+      net->heap = buf;
+
+      if (ntuple_attach(net, (const uint8_t *)buf, (size_t)len))
+         return true;
+   }
+
+   ntuple_free(net);
+   return false;
+}
+
+void ntuple_free(ntuple_t *net)
+{
+   game_unmap_file(net->map);
+   free(net->heap);
+   ntuple_setup(net);
+}
+
+/* Table index of every tuple under every symmetry, tuple by tuple. */
+static void ntuple_index(const ntuple_t *net, board_t b, uint32_t *index)
+{
+   int i, t, s, k, n = 0;
+   uint8_t cell[GRID_SIZE];
+
+   for (i = 0; i < GRID_SIZE; i++)
+   {
+      int v   = board_get(b, i);
+      cell[i] = (uint8_t)(v < NTUPLE_VALUES ? v : NTUPLE_VALUES - 1);
+   }
+
+   for (t = 0; t < net->tuples; t++)
+   {
+      for (s = 0; s < NTUPLE_SYMMETRIES; s++)
+      {
+         const uint8_t *c = net->sym[t][s];
+         uint32_t idx     = 0;
+
+         for (k = 0; k < net->count[t]; k++)
+            idx |= (uint32_t)cell[c[k]] << (k * NTUPLE_VALUE_BITS);
+
+         index[n++] = idx;
+      }
+   }
+}
+
+float ntuple_evaluate(const ntuple_t *net, board_t b)
+{
+   int t, s, n = 0;
+   uint32_t index[NTUPLE_MAX_TUPLES * NTUPLE_SYMMETRIES];
+   float sum = 0;
+
+   /* All indices first, then all lookups. The index loop only touches
+    * the cell bytes and vectorizes, the lookups are independent loads
+    * that can all be in flight at once. */
+   ntuple_index(net, b, index);
+
+   for (t = 0; t < net->tuples; t++)
+   {
+      const float *table = net->table[t];
+
+      for (s = 0; s < NTUPLE_SYMMETRIES; s++)
+         sum += table[index[n++]];
+   }
+
+   return sum;
+}
+
+void ntuple_update(ntuple_t *net, board_t b, float delta)
+{
+   int t, s, n = 0;
+   uint32_t index[NTUPLE_MAX_TUPLES * NTUPLE_SYMMETRIES];
+
+   ntuple_index(net, b, index);
+
+   for (t = 0; t < net->tuples; t++)
+   {
+      float *table = net->table[t];
+
+      for (s = 0; s < NTUPLE_SYMMETRIES; s++)
+         table[index[n++]] += delta;
+   }
+}
+
+bool ntuple_save(const ntuple_t *net, const char *path)
+{
+   int t;
+   bool ok;
+   RFILE *file = filestream_open(path, RETRO_VFS_FILE_ACCESS_WRITE,
+         RETRO_VFS_FILE_ACCESS_HINT_NONE);
+
+   if (!file)
+      return false;
+
+   ok = filestream_write(file, &net->header, NTUPLE_HEADER_SIZE) == NTUPLE_HEADER_SIZE;
+
+   for (t = 0; t < net->tuples && ok; t++)
+   {
+      int64_t size = (int64_t)(net->size[t] * sizeof(float));
+      ok = filestream_write(file, net->table[t], size) == size;
+   }
+
+   return filestream_close(file) == 0 && ok;
+}
@@ -0,0 +1,83 @@
+#ifndef _GAME_NTUPLE_H
+#define _GAME_NTUPLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <boolean.h>
+
+#include "game_board.h"
+#include "game_mmap.h"
+
+/* N-tuple network: a board is valued as the sum of one table lookup
+ * per tuple and symmetry. A tuple is a fixed group of 4 to 6 cells
+ * whose exponents, capped at NTUPLE_VALUES - 1, index its table; each
+ * tuple is sampled in all 8 rotations and reflections of the board and
+ * the samples share the table.
+ *
+ * Weights file: an ntuple_header_t, then the tables of all tuples as
+ * native floats, back to back. Every table is a multiple of 64 bytes
+ * and starts 64-byte aligned in the file, so a mapped file is used in
+ * place. */
+
+#define NTUPLE_MAGIC        0x4c50544eu /* "NTPL" when little endian */
+#define NTUPLE_VERSION      1
+#define NTUPLE_HEADER_SIZE  128
+
+#define NTUPLE_MAX_TUPLES   8
+#define NTUPLE_MAX_CELLS    6
+#define NTUPLE_SYMMETRIES   8
+#define NTUPLE_VALUE_BITS   4
+#define NTUPLE_VALUES       (1 << NTUPLE_VALUE_BITS)
+
+typedef struct
+{
+   uint32_t magic;
+   uint32_t version;
+   uint8_t width;
+   uint8_t height;
+   uint8_t tuples;
+   uint8_t reserved;
+   uint32_t reserved2;
+   /* self-play games the weights were trained on */
+   uint64_t games;
+   /* cell indices of every tuple, 0xff past its last cell */
+   uint8_t cells[NTUPLE_MAX_TUPLES][NTUPLE_MAX_CELLS];
+   uint8_t padding[NTUPLE_HEADER_SIZE - 24 - NTUPLE_MAX_TUPLES * NTUPLE_MAX_CELLS];
+} ntuple_header_t;
+
+typedef struct
+{
+   ntuple_header_t header;
+   int tuples;
+   int count[NTUPLE_MAX_TUPLES];
+   size_t size[NTUPLE_MAX_TUPLES];
+   float *table[NTUPLE_MAX_TUPLES];
+   /* cells of every tuple under every symmetry */
+   uint8_t sym[NTUPLE_MAX_TUPLES][NTUPLE_SYMMETRIES][NTUPLE_MAX_CELLS];
+
+   /* where the weights live, one of the two */
+   game_map_t *map;
+   void *heap;
+} ntuple_t;
+
+/* Sets up the tuples of this board size with every weight at 0. */
+bool ntuple_alloc(ntuple_t *net);
+
+/* Loads a weights file made for this board size, mapped where the
+ * platform allows and read into memory otherwise. */
+bool ntuple_load(ntuple_t *net, const char *path);
+void ntuple_free(ntuple_t *net);
+
+/* Sum of the weights of every tuple and symmetry. */
+float ntuple_evaluate(const ntuple_t *net, board_t b);
+
+/* Adds 'delta' to every weight ntuple_evaluate() sums for 'b'. Only
+ * for allocated networks, a mapped file is read-only. There is no
+ * locking: threads training one network may lose an update now and
+ * then when they hit the same weight, which the learning shrugs off. */
+void ntuple_update(ntuple_t *net, board_t b, float delta);
+
+/* Writes the network in the weights file format. */
+bool ntuple_save(const ntuple_t *net, const char *path);
+
+#endif
@@ -0,0 +1,273 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "game_pool.h"
+#include "game_thread.h"
+
+#ifdef HAVE_GAME_THREADS
+
+typedef struct
+{
+   game_mutex_t *lock;
+   int head;
+   int tail;
+   int task[POOL_MAX_TASKS];
+} pool_deque_t;
+
+static game_thread_t *workers[POOL_MAX_THREADS];
+static pool_deque_t deques[POOL_MAX_THREADS];
+
+static game_mutex_t *pool_lock = NULL;
+static game_cond_t *pool_wake  = NULL;
+static game_cond_t *pool_done  = NULL;
+
+static unsigned pool_batch = 0;
+static int pool_pending    = 0;
+static bool pool_stop      = false;
+static bool pool_busy      = false;
+
+static pool_task_t batch_fn = NULL;
+static char *batch_args     = NULL;
+static size_t batch_stride  = 0;
+
+#endif
+
+static int pool_count = 1;
+
+#ifdef HAVE_GAME_THREADS
+
+static bool take_task(int self, int *task)
+{
+   int i;
+
+   for (i = 0; i < pool_count; i++)
+   {
+      pool_deque_t *d = &deques[(self + i) % pool_count];
+      bool found      = false;
+
+      game_mutex_lock(d->lock);
+
+      if (d->tail > d->head)
+      {
+         /* own work newest first, stolen work oldest first */
+         *task = i ? d->task[d->head++] : d->task[--d->tail];
+         found = true;
+      }
+
+      game_mutex_unlock(d->lock);
+
+      if (found)
+         return true;
+   }
+
+   return false;
+}
+
+static void work(int self)
+{
+   int task, done = 0;
+
+   while (take_task(self, &task))
+   {
+      batch_fn(batch_args + task * batch_stride);
+      done++;
+   }
+
+   if (!done)
+      return;
+
+   game_mutex_lock(pool_lock);
+   pool_pending -= done;
+   if (!pool_pending)
+      game_cond_broadcast(pool_done);
+   game_mutex_unlock(pool_lock);
+}
+
+static void worker_main(void *data)
+{
+   int self      = (int)(intptr_t)data;
+   unsigned seen = 0;
+
+   game_mutex_lock(pool_lock);
+
+   for (;;)
+   {
+      while (!pool_stop && pool_batch == seen)
+         game_cond_wait(pool_wake, pool_lock);
+
+      if (pool_stop)
+         break;
+
+      seen = pool_batch;
+
+      game_mutex_unlock(pool_lock);
+      work(self);
+      game_mutex_lock(pool_lock);
+   }
+
+   game_mutex_unlock(pool_lock);
+}
+
+#endif
+
+bool pool_init(int threads)
+{
+#ifdef HAVE_GAME_THREADS
+   int i;
+
+   pool_deinit();
+
+   if (threads <= 0)
+      threads = game_cpu_count();
+   if (threads > POOL_MAX_THREADS)
+      threads = POOL_MAX_THREADS;
+
+   if (threads < 2)
+      return true;
+
+   pool_lock = game_mutex_create();
+   pool_wake = game_cond_create();
+   pool_done = game_cond_create();
+
+   if (!pool_lock || !pool_wake || !pool_done)
+      goto error;
+
+   for (i = 0; i < threads; i++)
+   {
+      deques[i].head = deques[i].tail = 0;
+      if (!(deques[i].lock = game_mutex_create()))
+         goto error;
+   }
+
+   pool_stop    = false;
+   pool_busy    = false;
+   pool_batch   = 0;
+   pool_pending = 0;
+   pool_count   = threads;
+
+   for (i = 1; i < threads; i++)
+   {
+      if (!(workers[i] = game_thread_create(worker_main, (void *)(intptr_t)i)))
+         goto error;
+   }
+
+   return true;
+
+error:
+   pool_deinit();
+   return false;
+#else
+   (void)threads;
+   return true;
+#endif
+}
+
+void pool_deinit(void)
+{
+#ifdef HAVE_GAME_THREADS
+   int i;
+
+   if (pool_lock)
+   {
+      game_mutex_lock(pool_lock);
+      pool_stop = true;
+      game_cond_broadcast(pool_wake);
+      game_mutex_unlock(pool_lock);
+   }
+
+   for (i = 0; i < POOL_MAX_THREADS; i++)
+   {
+      game_thread_join(workers[i]);
+      game_mutex_free(deques[i].lock);
+      workers[i]     = NULL;
+      deques[i].lock = NULL;
+   }
+
+   game_cond_free(pool_done);
+   game_cond_free(pool_wake);
+   game_mutex_free(pool_lock);
+
+   pool_done = NULL;
+   pool_wake = NULL;
+   pool_lock = NULL;
+#endif
+
+   pool_count = 1;
+}
+
+int pool_threads(void)
+{
+   return pool_count;
+}
+
+void pool_run(pool_task_t fn, void *args, size_t stride, int count)
+{
+   int i;
+   bool serial = pool_count < 2 || count < 2;
+
+#ifdef HAVE_GAME_THREADS
+   if (!serial)
+   {
+      game_mutex_lock(pool_lock);
+      if (pool_busy)
+         serial = true;
+      else
+         pool_busy = true;
+      game_mutex_unlock(pool_lock);
+   }
+#endif
+
+   if (serial)
+   {
+      for (i = 0; i < count; i++)
+         fn((char *)args + i * stride);
+      return;
+   }
+
+#ifdef HAVE_GAME_THREADS
+   while (count > 0)
+   {
+      int batch = count < POOL_MAX_TASKS ? count : POOL_MAX_TASKS;
+
+      /* publish the batch before any task becomes visible, a worker
+       * still draining the previous one may pick it up right away */
+      game_mutex_lock(pool_lock);
+      batch_fn     = fn;
+      batch_args   = (char *)args;
+      batch_stride = stride;
+      pool_pending = batch;
+      game_mutex_unlock(pool_lock);
+
+      for (i = 0; i < pool_count; i++)
+      {
+         int t;
+         pool_deque_t *d = &deques[i];
+
+         game_mutex_lock(d->lock);
+         d->head = d->tail = 0;
+         for (t = i; t < batch; t += pool_count)
+            d->task[d->tail++] = t;
+         game_mutex_unlock(d->lock);
+      }
+
+      game_mutex_lock(pool_lock);
+      pool_batch++;
+      game_cond_broadcast(pool_wake);
+      game_mutex_unlock(pool_lock);
+
+      work(0);
+
+      game_mutex_lock(pool_lock);
+      while (pool_pending)
+         game_cond_wait(pool_done, pool_lock);
+      game_mutex_unlock(pool_lock);
+
+      args   = (char *)args + batch * stride;
+      count -= batch;
+   }
+
+   game_mutex_lock(pool_lock);
+   pool_busy = false;
+   game_mutex_unlock(pool_lock);
+#endif
+}
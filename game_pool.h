@@ -0,0 +1,28 @@
+#ifndef _GAME_POOL_H
+#define _GAME_POOL_H
+
+#include <stddef.h>
+#include <boolean.h>
+
+/* Work-stealing thread pool. Every worker owns a deque of task
+ * indices: it runs its own newest task first and, once empty, steals
+ * the oldest task of another worker. The calling thread takes part as
+ * worker 0, so a pool of N threads starts N - 1 of them. */
+
+#define POOL_MAX_THREADS 16
+#define POOL_MAX_TASKS   1024
+
+typedef void (*pool_task_t)(void *arg);
+
+/* 0 picks one thread per CPU. */
+bool pool_init(int threads);
+void pool_deinit(void);
+int pool_threads(void);
+
+/* Calls fn on each of the 'count' elements of 'args' (spaced 'stride'
+ * bytes apart) and returns once all of them are done. Tasks must only
+ * write to their own element. A nested or concurrent call runs its
+ * tasks serially on the calling thread. */
+void pool_run(pool_task_t fn, void *args, size_t stride, int count);
+
+#endif
@@ -0,0 +1,411 @@
+#include "game_replay.h"
+
+static const uint8_t replay_magic[4] = { '2', '0', '4', '8' };
+
+static size_t put_varint(uint8_t *out, uint64_t v)
+{
+   size_t n = 0;
+
+   while (v >= 0x80)
+   {
+      out[n++] = (uint8_t)(v | 0x80);
+      v      >>= 7;
+   }
+
+   out[n++] = (uint8_t)v;
+   return n;
+}
+
+static bool get_varint(replay_player_t *p, uint64_t *v)
+{
+   int shift = 0;
+
+   *v = 0;
+
+   while (p->pos < p->size && shift < 64)
+   {
+      uint8_t byte = p->data[p->pos++];
+
+      *v |= (uint64_t)(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+         return true;
+
+      shift += 7;
+   }
+
+   return false;
+}
+
+size_t replay_put_header(uint8_t *out)
+{
+   memcpy(out, replay_magic, sizeof(replay_magic));
+   out[4] = REPLAY_VERSION;
+   out[5] = GRID_WIDTH;
+   out[6] = GRID_HEIGHT;
+   out[7] = 0;
+
+   return REPLAY_HEADER_SIZE;
+}
+
+static size_t put_rng(uint8_t *out, const rng_t *rng)
+{
+   int i, j;
+
+   for (i = 0; i < 4; i++)
+      for (j = 0; j < 8; j++)
+         out[i * 8 + j] = (uint8_t)(rng->s[i] >> (j * 8));
+
+   return REPLAY_RNG_SIZE;
+}
+
+static bool get_rng(replay_player_t *p, rng_t *rng)
+{
+   int i, j;
+
+   if (p->size - p->pos < REPLAY_RNG_SIZE)
+      return false;
+
+   for (i = 0; i < 4; i++)
+   {
+      rng->s[i] = 0;
+      for (j = 0; j < 8; j++)
+         rng->s[i] |= (uint64_t)p->data[p->pos++] << (j * 8);
+   }
+
+   return true;
+}
+
+size_t replay_put_start(uint8_t *out, const rng_t *rng)
+{
+   out[0] = REPLAY_OP_START;
+   return 1 + put_rng(out + 1, rng);
+}
+
+size_t replay_put_move(uint8_t *out, direction_t dir)
+{
+   out[0] = (uint8_t)dir;
+   return 1;
+}
+
+size_t replay_put_spawn(uint8_t *out, int cell, int value)
+{
+   out[0] = (uint8_t)(REPLAY_OP_SPAWN | (value == 2 ? 0x40 : 0) | cell);
+   return 1;
+}
+
+size_t replay_put_board(uint8_t *out, int op, board_t b, int64_t score)
+{
+   int i;
+
+   out[0] = (uint8_t)op;
+
+   for (i = 0; i < GRID_SIZE; i++)
+      out[1 + i] = (uint8_t)board_get(b, i);
+
+   return 1 + GRID_SIZE + put_varint(out + 1 + GRID_SIZE, (uint64_t)score);
+}
+
+size_t replay_put_restore(uint8_t *out, board_t b, int64_t score, const rng_t *rng)
+{
+   size_t n = replay_put_board(out, REPLAY_OP_RESTORE, b, score);
+
+   return n + put_rng(out + n, rng);
+}
+
+replay_status_t replay_open(replay_player_t *p, const void *data, size_t size)
+{
+   memset(p, 0, sizeof(*p));
+   p->data = (const uint8_t *)data;
+   p->size = size;
+
+   if (size < REPLAY_HEADER_SIZE)
+      return REPLAY_TRUNCATED;
+
+   if (memcmp(p->data, replay_magic, sizeof(replay_magic)) ||
+       p->data[4] != REPLAY_VERSION ||
+       p->data[5] != GRID_WIDTH || p->data[6] != GRID_HEIGHT)
+      return REPLAY_BAD_RECORD;
+
+   p->pos = REPLAY_HEADER_SIZE;
+   return REPLAY_OK;
+}
+
+replay_status_t replay_read(replay_player_t *p, replay_record_t *rec)
+{
+   uint8_t byte;
+
+   if (p->pos >= p->size)
+      return REPLAY_EOF;
+
+   byte    = p->data[p->pos++];
+   rec->op = byte;
+
+   if (byte & REPLAY_OP_SPAWN)
+   {
+      rec->op    = REPLAY_OP_SPAWN;
+      rec->value = byte & 0x40 ? 2 : 1;
+      rec->cell  = byte & 0x3f;
+      return rec->cell < GRID_SIZE ? REPLAY_OK : REPLAY_BAD_RECORD;
+   }
+
+   if (byte >= DIR_UP && byte <= DIR_LEFT)
+   {
+      rec->value = byte;
+      return REPLAY_OK;
+   }
+
+   switch (byte)
+   {
+      case REPLAY_OP_START:
+         return get_rng(p, &rec->rng) ? REPLAY_OK : REPLAY_TRUNCATED;
+      case REPLAY_OP_UNDO:
+      case REPLAY_OP_RESTORE:
+      case REPLAY_OP_END:
+         {
+            int i;
+            uint64_t score;
+
+            if (p->size - p->pos < GRID_SIZE)
+               return REPLAY_TRUNCATED;
+
+            board_clear(rec->board);
+            for (i = 0; i < GRID_SIZE; i++)
+            {
+               int value = p->data[p->pos++];
+
+               if (value > BOARD_MAX_EXPONENT)
+                  return REPLAY_BAD_RECORD;
+               board_set(rec->board, i, value);
+            }
+
+            if (!get_varint(p, &score))
+               return REPLAY_TRUNCATED;
+
+            rec->score = (int64_t)score;
+
+            if (byte == REPLAY_OP_RESTORE && !get_rng(p, &rec->rng))
+               return REPLAY_TRUNCATED;
+         }
+         return REPLAY_OK;
+   }
+
+   return REPLAY_BAD_RECORD;
+}
+
+/* Whether 'rec' is the spawn add_tile() draws next, advancing the
+ * RNG past it. */
+static bool spawn_drawn(replay_player_t *p, const replay_record_t *rec)
+{
+   uint64_t empty = board_empty_mask(p->board);
+   int cell, value;
+
+   if (!empty)
+      return false;
+
+   cell  = board_mask_select(empty, (int)rng_range(&p->rng, board_mask_count(empty)));
+   value = rng_range(&p->rng, 10) ? 1 : 2;
+
+   return cell == rec->cell && value == rec->value;
+}
+
+static replay_status_t apply(replay_player_t *p, const replay_record_t *rec)
+{
+   board_t moved;
+   int64_t score = p->score;
+   unsigned i;
+
+   /* spawns come right after their move, nothing goes in between; past
+    * a save state the count is not known */
+   if (!p->restores && (rec->op == REPLAY_OP_SPAWN ? !p->spawns_due :
+            p->spawns_due && !p->spawn_optional))
+      return REPLAY_SPAWN_COUNT;
+
+   if (rec->op != REPLAY_OP_SPAWN)
+   {
+      p->spawns_due     = 0;
+      p->spawn_optional = false;
+   }
+
+   switch (rec->op)
+   {
+      case REPLAY_OP_START:
+         board_clear(p->board);
+         p->score          = 0;
+         p->history_count  = 0;
+         p->spawns_due     = 2;
+         p->won            = false;
+         p->rng            = rec->rng;
+         p->rng_known      = true;
+         break;
+      case REPLAY_OP_SPAWN:
+         if (board_get(p->board, rec->cell) ||
+               (p->rng_known && !spawn_drawn(p, rec)))
+            return REPLAY_BAD_SPAWN;
+         board_set(p->board, rec->cell, rec->value);
+         if (p->spawns_due)
+            p->spawns_due--;
+         p->spawn_optional = false;
+         break;
+      case REPLAY_OP_UNDO:
+         i = (p->history_head + UNDO_DEPTH - 1) % UNDO_DEPTH;
+
+         if (p->history_count && board_equal(rec->board, p->history[i]) &&
+               rec->score == p->history_score[i])
+         {
+            p->history_head = i;
+            p->history_count--;
+            p->rng          = p->history_rng[i];
+         }
+         /* a save state brings its own undo positions, and with them
+          * RNG states this stream never saw */
+         else if (p->restores)
+         {
+            p->history_count = 0;
+            p->rng_known     = false;
+         }
+         else
+            return REPLAY_BAD_UNDO;
+
+         p->undos++;
+         p->board = rec->board;
+         p->score = rec->score;
+         break;
+      case REPLAY_OP_RESTORE:
+         p->restores++;
+         p->board          = rec->board;
+         p->score          = rec->score;
+         p->history_count  = 0;
+         p->rng            = rec->rng;
+         p->rng_known      = true;
+         break;
+      case REPLAY_OP_END:
+         if (!board_equal(rec->board, p->board) || rec->score != p->score)
+            return REPLAY_MISMATCH;
+         p->ends++;
+         break;
+      default:
+         moved = board_move(p->board, (direction_t)rec->value, &p->score);
+         if (board_equal(moved, p->board))
+            return REPLAY_ILLEGAL_MOVE;
+
+         /* the same ring the game keeps for undo */
+         p->history[p->history_head]       = p->board;
+         p->history_score[p->history_head] = score;
+         p->history_rng[p->history_head]   = p->rng;
+         p->history_head = (p->history_head + 1) % UNDO_DEPTH;
+         if (p->history_count < UNDO_DEPTH)
+            p->history_count++;
+
+         p->board      = moved;
+         p->spawns_due = 1;
+         p->moves++;
+
+         /* the core stops on the win screen before spawning, 2048_sim
+          * has no win screen and spawns */
+         p->spawn_optional = !p->won && board_max_exponent(moved) >= 11;
+         if (p->spawn_optional)
+            p->won = true;
+         break;
+   }
+
+   return REPLAY_OK;
+}
+
+/* How a game that played through cleanly comes out. */
+static replay_status_t finish(const replay_player_t *p)
+{
+   if (p->restores)
+      return REPLAY_UNVERIFIABLE;
+   return p->spawns_due && !p->spawn_optional ? REPLAY_SPAWN_COUNT : REPLAY_OK;
+}
+
+replay_status_t replay_play_game(replay_player_t *p)
+{
+   replay_record_t rec;
+   replay_status_t status = replay_read(p, &rec);
+
+   if (status != REPLAY_OK)
+      return status;
+
+   if (rec.op != REPLAY_OP_START && rec.op != REPLAY_OP_RESTORE)
+      return REPLAY_BAD_RECORD;
+
+   p->moves          = 0;
+   p->undos          = 0;
+   p->restores       = 0;
+   p->ends           = 0;
+   p->spawns_due     = 0;
+   p->spawn_optional = false;
+
+   for (;;)
+   {
+      size_t pos;
+
+      if ((status = apply(p, &rec)) != REPLAY_OK)
+         return status;
+
+      pos = p->pos;
+
+      if ((status = replay_read(p, &rec)) == REPLAY_EOF)
+         return finish(p);
+      if (status != REPLAY_OK)
+         return status;
+
+      /* leave the next game to the next call */
+      if (rec.op == REPLAY_OP_START)
+      {
+         p->pos = pos;
+         return finish(p);
+      }
+   }
+}
+
+replay_status_t replay_skip_game(replay_player_t *p)
+{
+   for (;;)
+   {
+      replay_record_t rec;
+      size_t pos             = p->pos;
+      replay_status_t status = replay_read(p, &rec);
+
+      if (status == REPLAY_EOF)
+         return REPLAY_OK;
+      if (status != REPLAY_OK)
+         return status;
+
+      if (rec.op == REPLAY_OP_START)
+      {
+         p->pos = pos;
+         return REPLAY_OK;
+      }
+   }
+}
+
+const char *replay_status_string(replay_status_t status)
+{
+   switch (status)
+   {
+      case REPLAY_OK:
+         return "ok";
+      case REPLAY_EOF:
+         return "end of stream";
+      case REPLAY_TRUNCATED:
+         return "truncated record";
+      case REPLAY_BAD_RECORD:
+         return "bad record";
+      case REPLAY_ILLEGAL_MOVE:
+         return "move that changes nothing";
+      case REPLAY_BAD_SPAWN:
+         return "spawn the tile RNG did not draw";
+      case REPLAY_MISMATCH:
+         return "game over board does not match";
+      case REPLAY_SPAWN_COUNT:
+         return "wrong number of spawns";
+      case REPLAY_BAD_UNDO:
+         return "undo to a position never played";
+      case REPLAY_UNVERIFIABLE:
+         return "save state loaded";
+   }
+
+   return "unknown";
+}
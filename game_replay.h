@@ -0,0 +1,136 @@
+#ifndef _GAME_REPLAY_H
+#define _GAME_REPLAY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <boolean.h>
+
+#include "game_board.h"
+#include "game_rng.h"
+
+/* Append-only replay stream: a header, then one record per event.
+ *
+ *   0x01-0x04   move, the direction_t value
+ *   0x08        new game, empty board and no score, followed by the
+ *               tile RNG state
+ *   0x09        undo, followed by a board
+ *   0x0a        board replaced from a save state, followed by a board
+ *               and the tile RNG state
+ *   0x0b        game over, followed by the board the game ended on
+ *   0x80-0xff   spawn, bit 6 set for a 4, low six bits the cell
+ *
+ * A board is GRID_SIZE exponent bytes and the score as a LEB128
+ * varint, the RNG state its four words in little endian. A played move
+ * costs two bytes. Spawns are stored as well, so a stream plays back
+ * without the generator, but every spawn can be checked against the
+ * draw the game would have made. */
+
+#define REPLAY_VERSION        2
+#define REPLAY_HEADER_SIZE    8
+
+#define REPLAY_RNG_SIZE       32
+
+/* largest record, for sizing write buffers */
+#define REPLAY_MAX_RECORD     (1 + GRID_SIZE + 10 + REPLAY_RNG_SIZE)
+
+#define REPLAY_OP_START       0x08
+#define REPLAY_OP_UNDO        0x09
+#define REPLAY_OP_RESTORE     0x0a
+#define REPLAY_OP_END         0x0b
+#define REPLAY_OP_SPAWN       0x80
+
+typedef enum
+{
+   REPLAY_OK,
+   REPLAY_EOF,
+   REPLAY_TRUNCATED,
+   REPLAY_BAD_RECORD,
+   REPLAY_ILLEGAL_MOVE,
+   /* a spawn the tile RNG did not draw */
+   REPLAY_BAD_SPAWN,
+   REPLAY_MISMATCH,
+   /* a move not followed by exactly the spawns the game makes */
+   REPLAY_SPAWN_COUNT,
+   /* an undo to a position that was not played before */
+   REPLAY_BAD_UNDO,
+   /* the game loaded a save state, so its board came from outside */
+   REPLAY_UNVERIFIABLE
+} replay_status_t;
+
+typedef struct
+{
+   int op;
+   /* direction of a move, exponent of a spawn */
+   int value;
+   int cell;
+   /* undo, restore and end */
+   board_t board;
+   int64_t score;
+   /* new game and restore */
+   rng_t rng;
+} replay_record_t;
+
+/* Plays a stream back through board_move(). */
+typedef struct
+{
+   const uint8_t *data;
+   size_t size;
+   size_t pos;
+
+   board_t board;
+   int64_t score;
+   unsigned moves;
+   unsigned undos;
+   unsigned restores;
+   /* game over records seen, each one matched the played board */
+   unsigned ends;
+
+   /* the game's tile RNG, unknown after an undo past a save state */
+   rng_t rng;
+   bool rng_known;
+
+   /* positions before the last moves, all an undo can go back to */
+   board_t history[UNDO_DEPTH];
+   int64_t history_score[UNDO_DEPTH];
+   rng_t history_rng[UNDO_DEPTH];
+   unsigned history_head;
+   unsigned history_count;
+   /* spawns the last move or new game still has to make, the one
+    * after the move that built the first 2048 may be left out */
+   int spawns_due;
+   bool spawn_optional;
+   bool won;
+} replay_player_t;
+
+/* Writers return the number of bytes put in 'out', which must have
+ * room for REPLAY_MAX_RECORD (REPLAY_HEADER_SIZE for the header). */
+size_t replay_put_header(uint8_t *out);
+size_t replay_put_start(uint8_t *out, const rng_t *rng);
+size_t replay_put_move(uint8_t *out, direction_t dir);
+size_t replay_put_spawn(uint8_t *out, int cell, int value);
+/* undo and game over */
+size_t replay_put_board(uint8_t *out, int op, board_t b, int64_t score);
+size_t replay_put_restore(uint8_t *out, board_t b, int64_t score, const rng_t *rng);
+
+/* Checks the header and positions the player on the first record. */
+replay_status_t replay_open(replay_player_t *p, const void *data, size_t size);
+
+/* Decodes the record at p->pos and steps past it. */
+replay_status_t replay_read(replay_player_t *p, replay_record_t *rec);
+
+/* Plays one game, from a new game (or a board restored before the
+ * first one) up to the next new game or the end of the stream. Every
+ * move must be followed by the spawns the game makes, drawn from the
+ * tile RNG the way add_tile() draws them, and every undo must go back
+ * to a position played before it. A game that loaded a
+ * save state plays to its end and returns REPLAY_UNVERIFIABLE. Returns
+ * REPLAY_EOF once there is nothing left to play. */
+replay_status_t replay_play_game(replay_player_t *p);
+
+/* Steps over records up to the next new game, without playing them.
+ * Used to get past a game that failed. */
+replay_status_t replay_skip_game(replay_player_t *p);
+
+const char *replay_status_string(replay_status_t status);
+
+#endif
@@ -0,0 +1,47 @@
+#include "game_rng.h"
+
+static uint64_t rotl(uint64_t x, int k)
+{
+   return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t splitmix64(uint64_t *x)
+{
+   uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+
+   z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+   z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+   return z ^ (z >> 31);
+}
+
+void rng_seed(rng_t *rng, uint64_t seed)
+{
+   int i;
+
+   /* splitmix64 never yields four zero words in a row */
+   for (i = 0; i < 4; i++)
+      rng->s[i] = splitmix64(&seed);
+}
+
+uint64_t rng_next(rng_t *rng)
+{
+   uint64_t *s     = rng->s;
+   uint64_t result = rotl(s[1] * 5, 7) * 9;
+   uint64_t t      = s[1] << 17;
+
+   s[2] ^= s[0];
+   s[3] ^= s[1];
+   s[1] ^= s[2];
+   s[0] ^= s[3];
+   s[2] ^= t;
+   s[3]  = rotl(s[3], 45);
+
+   return result;
+}
+
+uint32_t rng_range(rng_t *rng, uint32_t n)
+{
+   /* multiply-shift on the high bits, the bias for n <= 16 is far
+    * below anything a game could show */
+   return (uint32_t)(((rng_next(rng) >> 32) * n) >> 32);
+}
@@ -0,0 +1,22 @@
+#ifndef _GAME_RNG_H
+#define _GAME_RNG_H
+
+#include <stdint.h>
+
+/* xoshiro256** generator. The state is plain data so it can live in
+ * game_t and travel with save states, which keeps tile spawns
+ * deterministic across run-ahead, netplay and rewind. */
+
+typedef struct
+{
+   uint64_t s[4];
+} rng_t;
+
+/* Expands 'seed' with splitmix64, any value including 0 is fine. */
+void rng_seed(rng_t *rng, uint64_t seed);
+uint64_t rng_next(rng_t *rng);
+
+/* Uniform in [0, n), n > 0. */
+uint32_t rng_range(rng_t *rng, uint32_t n);
+
+#endif
@@ -1,19 +1,95 @@
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 #include <assert.h>
 #include "game_shared.h"
+#include "game_board.h"
+#include "game_anim.h"
+#include "game_ai.h"
+#include "game_hint.h"
+#include "game_stats.h"
+#include "game_pool.h"
+#include "game_replay.h"
 
 static game_t game;
 
-/* Score animations */
-static int delta_score;
-static float delta_score_time;
 static float frame_time = 0.016;
 
+/* AI autoplay, gets half of each frame to think */
+static bool autoplay = false;
+static retro_time_t autoplay_budget = 8000;
+static retro_perf_get_time_usec_t game_clock = NULL;
+
+/* Greedy rollouts from the paused position, stepped a few moves at a
+ * time while the frame budget lasts. Games on big boards run for many
+ * thousand moves, so they get fewer rollouts, and every rollout is cut
+ * off after STATS_MAX_MOVES. */
+#define STATS_ROLLOUTS    (GRID_SIZE <= 16 ? 1024 : 1024 * 16 / GRID_SIZE)
+#define STATS_MAX_MOVES   (GRID_SIZE * 256)
+#define STATS_STEP_MOVES  2
+static stats_batch_t stats;
+static bool stats_valid = false;
+static bool stats_complete = false;
+
+/* a fixed seed replays the same tile sequence on every new game */
+static bool seed_fixed = false;
+static uint64_t seed_value = 0;
+
+/* replay recording, handed to the sink a buffer at a time */
+static game_replay_sink_t replay_sink = NULL;
+static uint8_t replay_buf[4096];
+static size_t replay_len = 0;
+
+/* Stream position and game at the last save state. Run-ahead and
+ * rewind load states all the time and what was recorded after the
+ * state never happened, so it stays in replay_buf until the buffer
+ * fills up and is dropped again when a state is loaded. */
+static bool replay_marked = false;
+static size_t replay_mark = 0;
+static board_t mark_board;
+static int64_t mark_score;
+static bool mark_in_game;
+
 #define PI 3.14159
 
+/* Hands the first 'len' bytes to the sink. */
+static void replay_write(size_t len)
+{
+   if (len && replay_sink)
+      replay_sink(replay_buf, len);
+
+   memmove(replay_buf, replay_buf + len, replay_len - len);
+   replay_len -= len;
+   if (replay_marked)
+      replay_mark -= len;
+}
+
+/* Hands out what no save state can take back. */
+static void replay_flush(void)
+{
+   replay_write(replay_marked ? replay_mark : replay_len);
+}
+
+static void replay_flush_all(void)
+{
+   replay_marked = false;
+   replay_write(replay_len);
+}
+
+/* room for one more record, only valid while a sink is set */
+static uint8_t *replay_reserve(void)
+{
+   if (replay_len + REPLAY_MAX_RECORD > sizeof(replay_buf))
+      replay_flush();
+   /* a mark a whole buffer back is given up */
+   if (replay_len + REPLAY_MAX_RECORD > sizeof(replay_buf))
+      replay_flush_all();
+   return replay_buf + replay_len;
+}
+
 /* out back bicubic
  * from http://www.timotheegroleau.com/Flash/experiments/easing_function_generator.htm
  */
@@ -49,20 +125,6 @@ void *game_data(void)
 
 void *game_save_data(void)
 {
-   int row, col;
-
-   /* stop animations */
-   for (row = 0; row < 4; row++)
-   {
-      for (col = 0; col < 4; col++)
-      {
-         game.grid[row * 4 + col].appear_time = 1;
-         game.grid[row * 4 + col].move_time   = 1;
-      }
-   }
-
-   delta_score_time = 1;
-
    /* show title screen when the game gets loaded again. */
    if (game.state != STATE_PLAYING && game.state != STATE_PAUSED)
    {
@@ -78,6 +140,59 @@ unsigned game_data_size(void)
    return sizeof(game);
 }
 
+/* Save files and states come from outside, so anything used as an index
+ * is brought into range: the undo ring is clamped and a state or board
+ * the core does not know fails the data. */
+static bool check_data(game_t *g)
+{
+   unsigned i;
+
+   if ((unsigned)g->state > STATE_PAUSED || !board_valid(g->board))
+      return false;
+
+   g->undo_head %= UNDO_DEPTH;
+   if (g->undo_count > UNDO_DEPTH)
+      g->undo_count = 0;
+
+   /* keep the moves back up to the first bad board */
+   for (i = 0; i < g->undo_count; i++)
+      if (!board_valid(g->undo[(g->undo_head + UNDO_DEPTH - 1 - i) % UNDO_DEPTH].board))
+         g->undo_count = i;
+
+   g->empty_cells     = board_empty_mask(g->board);
+   g->moves_available = g->empty_cells || board_can_move(g->board);
+   return true;
+}
+
+bool game_load_data(const void *data)
+{
+   static game_t loaded;
+
+   memcpy(&loaded, data, sizeof(loaded));
+
+   if (!check_data(&loaded))
+      return false;
+
+   game = loaded;
+   return true;
+}
+
+bool game_check_data(void)
+{
+   int64_t best_score = game.best_score;
+
+   if (check_data(&game))
+      return true;
+
+   /* nothing of it can be trusted but the best score */
+   memset(&game, 0, sizeof(game));
+   rng_seed(&game.rng, (uint64_t)time(NULL));
+   game.best_score = best_score > 0 ? best_score : 0;
+   game.state      = STATE_TITLE;
+   anim_reset(game.board);
+   return false;
+}
+
 void render_game(void)
 {
    if (game.state == STATE_PLAYING)
@@ -93,27 +208,23 @@ void render_game(void)
 static void add_tile(void)
 {
    int i, j;
-   cell_t *empty[GRID_SIZE];
 
    if (game.state != STATE_PLAYING)
       return;
 
-   j = 0;
-   for (i = 0; i < GRID_SIZE; i++)
+   if (game.empty_cells)
    {
-      empty[j] = NULL;
-      if (!game.grid[i].value)
-         empty[j++] = &game.grid[i];
-   }
+      j = rng_range(&game.rng, board_mask_count(game.empty_cells));
+      i = board_mask_select(game.empty_cells, j);
+      board_set(game.board, i, rng_range(&game.rng, 10) ? 1 : 2);
 
-   if (j)
-   {
-      j = rand() % j;
-      empty[j]->old_pos = empty[j]->pos;
-      empty[j]->source = NULL;
-      empty[j]->move_time = 1;
-      empty[j]->appear_time = 0;
-      empty[j]->value = ((float)rand() / RAND_MAX) < 0.9 ? 1 : 2;
+      if (replay_sink)
+         replay_len += replay_put_spawn(replay_reserve(), i, board_get(game.board, i));
+
+      game.empty_cells    &= ~((uint64_t)1 << i);
+      game.moves_available = game.empty_cells || board_can_move(game.board);
+
+      anim_spawn(i, board_get(game.board, i));
    }
    else
       change_state(STATE_GAME_OVER);
@@ -121,206 +232,134 @@ static void add_tile(void)
 
 void init_game(void)
 {
+   /* the AI sets itself up, search memory included, on the first
+    * autoplay or hint search */
+   board_init_tables();
+   pool_init(0);
+   hint_init();
+
    memset(&game, 0, sizeof(game));
+   rng_seed(&game.rng, (uint64_t)time(NULL));
 
    game.state = STATE_TITLE;
 }
 
+void deinit_game(void)
+{
+   replay_flush_all();
+   hint_deinit();
+   pool_deinit();
+   ai_deinit();
+}
+
 void start_game(void)
 {
-   int row, col;
    game.score = 0;
 
-   for (row = 0; row < 4; row++)
-   {
-      for (col = 0; col < 4; col++)
-      {
-         cell_t *cell = &game.grid[row * 4 + col];
-
-         cell->pos.x = col;
-         cell->pos.y = row;
-         cell->old_pos = cell->pos;
-         cell->move_time = 1;
-         cell->appear_time = 0;
-         cell->value = 0;
-         cell->source = NULL;
-      }
-   }
+   hint_cancel();
+
+   board_clear(game.board);
+   game.undo_count      = 0;
+   game.empty_cells     = BOARD_CELL_MASK;
+   game.moves_available = false;
+   game.won_before      = false;
 
-   game.won_before = false;
+   if (seed_fixed)
+      rng_seed(&game.rng, seed_value);
 
-   /* reset +score animation */
-   delta_score      = 0;
-   delta_score_time = 1;
+   /* only a game in play gets its spawns, elsewhere the board is
+    * just cleared */
+   if (replay_sink && game.state == STATE_PLAYING)
+      replay_len += replay_put_start(replay_reserve(), &game.rng);
+
+   anim_reset(game.board);
 
    add_tile();
    add_tile();
 }
 
-static bool cells_available(void)
+static void push_undo(void)
 {
-   int row, col;
-   for (row = 0; row < GRID_HEIGHT; row++)
-   {
-      for (col = 0; col < GRID_WIDTH; col++)
-      {
-         if (!game.grid[row * GRID_WIDTH + col].value)
-            return true;
-      }
-   }
+   undo_entry_t *entry = &game.undo[game.undo_head];
 
-   return false;
+   entry->board = game.board;
+   entry->rng   = game.rng;
+   entry->score = game.score;
+
+   game.undo_head = (game.undo_head + 1) % UNDO_DEPTH;
+   if (game.undo_count < UNDO_DEPTH)
+      game.undo_count++;
 }
 
-static bool matches_available(void)
+/* Puts back the board, score and tile RNG from before the last move,
+ * so the same move brings back the same spawn. */
+static bool undo_move(void)
 {
-   int row, col;
-   for (row = 0; row < GRID_HEIGHT; row++)
-   {
-      for (col = 0; col < GRID_WIDTH; col++)
-      {
-         cell_t *cell = &game.grid[row * GRID_WIDTH + col];
+   undo_entry_t *entry;
 
-         if (!cell->value)
-            continue;
+   if (!game.undo_count)
+      return false;
 
-         if ((col > 0 && game.grid[row * GRID_WIDTH + col - 1].value == cell->value) ||
-             (col < GRID_WIDTH - 1 && game.grid[row * GRID_WIDTH + col + 1].value == cell->value) ||
-             (row > 0 && game.grid[(row - 1) * GRID_WIDTH + col].value == cell->value) ||
-             (row < GRID_HEIGHT - 1 && game.grid[(row + 1) * GRID_WIDTH + col].value == cell->value))
-            return true;
-      }
-   }
+   hint_cancel();
 
-   return false;
-}
+   game.undo_head = (game.undo_head + UNDO_DEPTH - 1) % UNDO_DEPTH;
+   game.undo_count--;
+   entry = &game.undo[game.undo_head];
 
-static bool move_tiles(void)
-{
-   int row, col;
-   int vec_x, vec_y;
-   int col_begin, col_end, col_inc;
-   int row_begin, row_end, row_inc;
-   bool moved = false;
+   game.board           = entry->board;
+   game.rng             = entry->rng;
+   game.score           = entry->score;
+   game.empty_cells     = board_empty_mask(game.board);
+   game.moves_available = true;
 
-   switch (game.direction)
-   {
-      case DIR_UP:
-         vec_x = 0; vec_y = -1;
-         break;
-      case DIR_DOWN:
-         vec_x = 0; vec_y = 1;
-         break;
-      case DIR_RIGHT:
-         vec_x = 1; vec_y = 0;
-         break;
-      case DIR_LEFT:
-         vec_x = -1; vec_y = 0;
-         break;
-      default:
-         return false;
-   }
-
-   col_begin = 0;
-   col_end   = 4;
-   col_inc   = 1;
-   row_begin = 0;
-   row_end   = 4;
-   row_inc   = 1;
-
-   if (vec_x > 0) {
-      col_begin = 3;
-      col_end   = -1;
-      col_inc   = -1;
-   }
+   anim_reset(game.board);
 
-   if (vec_y > 0)
-   {
-      row_begin = 3;
-      row_end   = -1;
-      row_inc   = -1;
-   }
+   if (replay_sink)
+      replay_len += replay_put_board(replay_reserve(), REPLAY_OP_UNDO,
+            game.board, game.score);
 
-   delta_score = game.score;
+   return true;
+}
 
-   /* clear source cell and save current position in the grid */
-   for (row = row_begin; row != row_end; row += row_inc)
-   {
-      for (col = col_begin; col != col_end; col += col_inc)
-      {
-         cell_t *cell = &game.grid[row * 4 + col];
-         cell->old_pos = cell->pos;
-         cell->source = NULL;
-         cell->move_time = 1;
-         cell->appear_time = 1;
-      }
-   }
+static bool move_tiles(void)
+{
+   int64_t score = 0;
+   board_t moved;
 
-   for (row = row_begin; row != row_end; row += row_inc)
-   {
-      for (col = col_begin; col != col_end; col += col_inc)
-      {
-         int new_row, new_col;
-         cell_t *farthest, *next;
-         cell_t *cell = &game.grid[row * 4 + col];
+   if (game.direction == DIR_NONE)
+      return false;
 
-         if (!cell->value)
-            continue;
+   moved = board_move(game.board, game.direction, &score);
 
-         next    = cell;
-         new_row = row;
-         new_col = col;
+   if (board_equal(moved, game.board))
+      return false;
 
-         do
-         {
-            farthest = next;
+   push_undo();
+   hint_cancel();
 
-            new_row += vec_y;
-            new_col += vec_x;
+   if (replay_sink)
+      replay_len += replay_put_move(replay_reserve(), game.direction);
 
-            if (new_row < 0 || new_col < 0 || new_row > 3 || new_col > 3)
-               break;
+   anim_move(game.board, moved, game.direction, score);
 
-            next = &game.grid[new_row * 4 + new_col];
-         } while (!next->value);
+   game.board       = moved;
+   game.empty_cells = board_empty_mask(moved);
+   game.score      += score;
 
-         /* only tiles that have not been merged */
-         if (next->value && next->value == cell->value && next != cell && !next->source)
-         {
-            next->value = cell->value + 1;
-            next->source = cell;
-            next->old_pos = cell->pos;
-            next->move_time = 0;
-            cell->value = 0;
-
-            game.score += 2 << next->value;
-            moved = true;
-
-            if (next->value == 11 && !game.won_before)
-            {
-               game.won_before = true;
-               change_state(STATE_WON);
-            }
-         }
-         else if (farthest != cell)
-         {
-            farthest->value = cell->value;
-            farthest->old_pos = cell->pos;
-            farthest->move_time = 0;
-            cell->value = 0;
-            moved = true;
-         }
-      }
+   if (!game.won_before && board_max_exponent(moved) >= 11)
+   {
+      game.won_before = true;
+      change_state(STATE_WON);
    }
 
-   delta_score      = game.score - delta_score;
-   delta_score_time = delta_score == 0 ? 1 : 0;
-
-   return moved;
+   return true;
 }
 
 void game_update(float delta, key_state_t *new_ks)
 {
+   /* the hint search on pausing shares the budget with the rollouts */
+   retro_time_t start = game_clock ? game_clock() : 0;
+
    frame_time = delta;
 
    handle_input(new_ks);
@@ -330,9 +369,32 @@ void game_update(float delta, key_state_t *new_ks)
       if (game.direction != DIR_NONE && move_tiles())
          add_tile();
 
-      if (!matches_available() && !cells_available())
+      if (!game.moves_available)
          change_state(STATE_GAME_OVER);
    }
+   else if (game.state == STATE_PAUSED)
+   {
+      /* start over whenever the position changed under us, e.g. after
+       * loading a save state */
+      if (!stats_valid || !board_equal(stats.start, game.board) ||
+          stats.start_score != game.score)
+      {
+         rng_t rng = game.rng;
+
+         stats_start(&stats, game.board, game.score, rng_next(&rng),
+               STATS_ROLLOUTS, STATS_MAX_MOVES, STATS_POLICY_GREEDY);
+         stats_valid    = true;
+         stats_complete = false;
+      }
+
+      if (!stats_complete)
+      {
+         /* one step a frame without a clock */
+         do
+            stats_complete = stats_step(&stats, STATS_STEP_MOVES);
+         while (!stats_complete && game_clock && game_clock() - start < autoplay_budget);
+      }
+   }
 }
 
 float *game_get_frame_time(void)
@@ -340,28 +402,32 @@ float *game_get_frame_time(void)
    return &frame_time;
 }
 
-int *game_get_delta_score(void)
+bool game_get_stats(stats_t *out)
 {
-   return &delta_score;
+   if (!stats_valid)
+      return false;
+
+   stats_result(&stats, out);
+   return stats_complete;
 }
 
-float *game_get_delta_score_time(void)
+direction_t game_get_hint(void)
 {
-   return &delta_score_time;
+   return hint_get(game.board);
 }
 
-int game_get_score(void)
+int64_t game_get_score(void)
 {
    return game.score;
 }
 
-int game_get_best_score(void)
+int64_t game_get_best_score(void)
 {
    return game.best_score;
 }
-cell_t * game_get_grid(void)
+board_t game_get_board(void)
 {
-   return game.grid;
+   return game.board;
 }
 
 game_state_t game_get_state(void)
@@ -388,6 +454,12 @@ void change_state(game_state_t state)
          assert(state == STATE_GAME_OVER || state == STATE_WON || state == STATE_PAUSED);
          if (state != STATE_PAUSED)
             end_game();
+         if (state == STATE_GAME_OVER && replay_sink)
+         {
+            replay_len += replay_put_board(replay_reserve(), REPLAY_OP_END,
+                  game.board, game.score);
+            replay_flush();
+         }
          break;
       case STATE_WON:
          end_game();
@@ -408,6 +480,9 @@ void handle_input(key_state_t *ks)
    {
       if (!ks->start && game.old_ks.start)
          change_state(game.state == STATE_WON ? STATE_TITLE : STATE_PLAYING);
+      /* back into the game from the last position */
+      else if (game.state == STATE_GAME_OVER && ks->undo && !game.old_ks.undo && undo_move())
+         game.state = STATE_PLAYING;
       else if (game.state == STATE_WON && !ks->select && game.old_ks.select)
       {
          change_state(STATE_PLAYING);
@@ -425,7 +500,17 @@ void handle_input(key_state_t *ks)
       else if (ks->left && !game.old_ks.left)
          game.direction = DIR_LEFT;
       else if (ks->start && !game.old_ks.start)
+      {
          change_state(STATE_PAUSED);
+         if (!autoplay)
+            hint_request(game.board, autoplay_budget);
+      }
+      else if (ks->undo && !game.old_ks.undo)
+         undo_move();
+      else if (ks->hint && !game.old_ks.hint && !autoplay)
+         hint_request(game.board, autoplay_budget);
+      else if (autoplay)
+         game.direction = ai_best_move(game.board, AI_MAX_DEPTH, autoplay_budget);
    }
    else if (game.state == STATE_PAUSED)
    {
@@ -443,11 +528,160 @@ void handle_input(key_state_t *ks)
 
 void game_reset(void)
 {
+   /* a paused game restarts like a new game from the pause screen */
+   if (game.state == STATE_PAUSED)
+      game.state = STATE_PLAYING;
+
    start_game();
 }
 
+void game_set_clock(retro_perf_get_time_usec_t get_time_usec)
+{
+   game_clock = get_time_usec;
+   ai_set_clock(get_time_usec);
+}
+
+void game_set_frame_budget(retro_time_t usec)
+{
+   autoplay_budget = usec / 2;
+}
+
+/* Settings below change the AI under a running hint search, so it
+ * has to stop first. */
+void game_set_autoplay(bool enabled)
+{
+   if (enabled)
+      hint_stop();
+   autoplay = enabled;
+}
+
+void game_set_ai_memory(size_t bytes)
+{
+   hint_stop();
+   ai_set_memory(bytes);
+}
+
+bool game_set_ai_weights(const char *path)
+{
+   hint_stop();
+   return ai_load_weights(path);
+}
+
+bool game_set_ai_tablebase(const char *path)
+{
+   hint_stop();
+   return ai_load_tablebase(path);
+}
+
+void game_set_seed(bool fixed, uint64_t seed)
+{
+   seed_fixed = fixed;
+   seed_value = seed;
+}
+
+void game_set_replay_sink(game_replay_sink_t sink)
+{
+   if (sink == replay_sink)
+      return;
+
+   replay_flush_all();
+   replay_sink = sink;
+   game_replay_sync();
+}
+
+void game_replay_mark(void)
+{
+   if (!replay_sink)
+      return;
+
+   replay_marked = true;
+   replay_mark   = replay_len;
+   mark_board    = game.board;
+   mark_score    = game.score;
+   mark_in_game  = game.state != STATE_TITLE;
+}
+
+void game_replay_sync(void)
+{
+   bool in_game = game.state != STATE_TITLE;
+
+   if (!replay_sink)
+      return;
+
+   if (replay_marked)
+   {
+      replay_len = replay_mark;
+
+      /* the game the stream was at, nothing to record */
+      if (in_game == mark_in_game && (!in_game ||
+            (board_equal(game.board, mark_board) && game.score == mark_score)))
+         return;
+   }
+
+   /* a game in progress continues from wherever it was loaded */
+   if (in_game)
+      replay_len += replay_put_restore(replay_reserve(),
+            game.board, game.score, &game.rng);
+}
+
 void grid_to_screen(vector_t pos, int *x, int *y)
 {
    *x = SPACING * 2 + ((TILE_SIZE + SPACING) * pos.x);
    *y = BOARD_OFFSET_Y + SPACING + ((TILE_SIZE + SPACING) * pos.y);
 }
+
+
+void format_number(char *out, size_t size, int64_t value, int digits)
+{
+   static const char units[] = "KMGTPE";
+   int64_t limit = 1, div = 1;
+   int unit = -1;
+
+   while (digits-- > 0 && limit <= INT64_MAX / 10)
+      limit *= 10;
+
+   if (value < limit)
+   {
+      snprintf(out, size, "%lld", (long long)value);
+      return;
+   }
+
+   /* at most three digits before the unit, cut rather than rounded so
+    * 999999 never turns into 1000K */
+   do
+   {
+      div *= 1000;
+      unit++;
+   } while (value / div >= 1000 && unit < 5);
+
+   if (value / div < 10)
+      snprintf(out, size, "%lld.%d%c", (long long)(value / div),
+            (int)(value % div / (div / 10)), units[unit]);
+   else
+      snprintf(out, size, "%lld%c", (long long)(value / div), units[unit]);
+}
+
+void format_tile_label(char *out, size_t size, int exponent)
+{
+   /* tiles are powers of two, so these units are too */
+   static const char units[] = "KMG";
+
+   if (exponent <= 0)
+      snprintf(out, size, "%s", "");
+   else if (exponent < 17)
+      snprintf(out, size, "%lu", 1ul << exponent);
+   else
+      snprintf(out, size, "%u%c", 1u << (exponent % 10), units[exponent / 10 - 1]);
+}
+
+const char *number_text(number_text_t *cache, int64_t value, int digits)
+{
+   if (!cache->valid || cache->value != value)
+   {
+      format_number(cache->text, sizeof(cache->text), value, digits);
+      cache->value = value;
+      cache->valid = true;
+   }
+
+   return cache->text;
+}
@@ -2,6 +2,8 @@
 #define _GAME_SHARED_H
 
 #include "game.h"
+#include "game_anim.h"
+#include "game_stats.h"
 
 float bump_out(float v0, float v1, float t);
 float lerp(float v0, float v1, float t);
@@ -12,17 +14,36 @@ void *game_save_data(void);
 unsigned game_data_size(void);
 void render_game(void);
 void init_game(void);
+void deinit_game(void);
 void start_game(void);
 void change_state(game_state_t state);
 game_state_t game_get_state(void);
 void handle_input(key_state_t *ks);
-int game_get_score(void);
-int game_get_best_score(void);
-cell_t * game_get_grid(void);
-int *game_get_delta_score(void);
-float *game_get_delta_score_time(void);
+int64_t game_get_score(void);
+int64_t game_get_best_score(void);
+board_t game_get_board(void);
 float *game_get_frame_time(void);
+/* rollout statistics for the paused position, true once complete */
+bool game_get_stats(stats_t *out);
+/* best move for the board on screen, DIR_NONE while none is known */
+direction_t game_get_hint(void);
 
 void grid_to_screen(vector_t pos, int *x, int *y);
 
+/* Decimal 'value', shortened to "1.2M" style once it takes more than
+ * 'digits' digits. */
+void format_number(char *out, size_t size, int64_t value, int digits);
+/* Label of a tile, "128K" style from 131072 up. */
+void format_tile_label(char *out, size_t size, int exponent);
+
+/* Text of a number on screen, formatted again only when it changes. */
+typedef struct
+{
+   bool valid;
+   int64_t value;
+   char text[16];
+} number_text_t;
+
+const char *number_text(number_text_t *cache, int64_t value, int digits);
+
 #endif
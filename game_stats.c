@@ -0,0 +1,190 @@
+#include <string.h>
+
+#include "game_stats.h"
+#include "game_pool.h"
+
+typedef struct
+{
+   stats_batch_t *batch;
+   int first;
+   int count;
+   int moves;
+} stats_slice_t;
+
+/* A few moves of every live lane in one slice. Each move is done for
+ * all lanes before the next, in batch passes: the four slides, then
+ * the picks, then the spawns. */
+static void stats_slice_run(void *data)
+{
+   stats_slice_t *slice = (stats_slice_t *)data;
+   stats_batch_t *s     = slice->batch;
+   board_t *board       = s->board + slice->first;
+   int64_t *score       = s->score + slice->first;
+   uint8_t *done        = s->done + slice->first;
+   int n                = slice->count;
+   board_t moved[DIR_LEFT + 1][STATS_SLICE];
+   int64_t gain[DIR_LEFT + 1][STATS_SLICE];
+   uint8_t changed[DIR_LEFT + 1][STATS_SLICE];
+   uint8_t live[STATS_SLICE];
+   int m, i, dir;
+
+   for (m = 0; m < slice->moves; m++)
+   {
+      int count_live = 0;
+
+      for (dir = DIR_UP; dir <= DIR_LEFT; dir++)
+      {
+         memcpy(moved[dir], board, n * sizeof(*board));
+         memset(gain[dir], 0, n * sizeof(int64_t));
+         board_move_batch(moved[dir], n, (direction_t)dir, gain[dir], changed[dir]);
+      }
+
+      for (i = 0; i < n; i++)
+      {
+         int count = 0, best = 0, best_empty = -1;
+         int legal[DIR_LEFT + 1];
+
+         live[i] = 0;
+
+         if (done[i])
+            continue;
+
+         for (dir = DIR_UP; dir <= DIR_LEFT; dir++)
+            if (changed[dir][i])
+               legal[count++] = dir;
+
+         if (!count)
+         {
+            done[i] = 1;
+            continue;
+         }
+
+         if (s->policy == STATS_POLICY_RANDOM)
+            best = legal[rng_range(&s->rng[slice->first + i], count)];
+         else
+         {
+            int k;
+
+            /* highest immediate score, more free cells on a tie */
+            for (k = 0; k < count; k++)
+            {
+               int d     = legal[k];
+               int empty = board_count_empty(moved[d][i]);
+
+               if (!best || gain[d][i] > gain[best][i] ||
+                   (gain[d][i] == gain[best][i] && empty > best_empty))
+               {
+                  best       = d;
+                  best_empty = empty;
+               }
+            }
+         }
+
+         board[i]  = moved[best][i];
+         score[i] += gain[best][i];
+         live[i]   = 1;
+         count_live++;
+      }
+
+      /* a move always frees a cell */
+      board_spawn_batch(board, s->rng + slice->first, live, n);
+
+      if (!count_live)
+         break;
+   }
+}
+
+void stats_start(stats_batch_t *s, board_t b, int64_t score, uint64_t seed,
+      int rollouts, int max_moves, stats_policy_t policy)
+{
+   int i;
+
+   if (rollouts > STATS_MAX_ROLLOUTS)
+      rollouts = STATS_MAX_ROLLOUTS;
+
+   s->start       = b;
+   s->start_score = score;
+   s->lanes       = rollouts;
+   s->policy      = policy;
+   s->moves       = 0;
+   s->max_moves   = max_moves;
+
+   for (i = 0; i < rollouts; i++)
+   {
+      s->board[i] = b;
+      s->score[i] = score;
+      s->done[i]  = 0;
+      rng_seed(&s->rng[i], seed + i);
+   }
+}
+
+bool stats_step(stats_batch_t *s, int moves)
+{
+   int i, count = 0;
+   stats_slice_t slices[STATS_MAX_ROLLOUTS / STATS_SLICE];
+
+   if (moves > s->max_moves - s->moves)
+      moves = s->max_moves - s->moves;
+
+   for (i = 0; i < s->lanes; i += STATS_SLICE)
+   {
+      slices[count].batch = s;
+      slices[count].first = i;
+      slices[count].count = s->lanes - i < STATS_SLICE ? s->lanes - i : STATS_SLICE;
+      slices[count].moves = moves;
+      count++;
+   }
+
+   pool_run(stats_slice_run, slices, sizeof(*slices), count);
+   s->moves += moves;
+
+   /* what is still going at the cut-off ends where it is */
+   if (s->moves >= s->max_moves)
+      memset(s->done, 1, s->lanes);
+
+   for (i = 0; i < s->lanes; i++)
+      if (!s->done[i])
+         return false;
+
+   return true;
+}
+
+void stats_result(const stats_batch_t *s, stats_t *out)
+{
+   int i, t;
+   double score = 0;
+   int reached[STATS_TARGETS] = {0};
+   int first = board_max_exponent(s->start) + 1;
+
+   /* the tile at hand is always reached, the next ones tell more */
+   if (first > BOARD_MAX_EXPONENT - STATS_TARGETS + 1)
+      first = BOARD_MAX_EXPONENT - STATS_TARGETS + 1;
+
+   out->done     = 0;
+   out->rollouts = s->lanes;
+
+   for (t = 0; t < STATS_TARGETS; t++)
+      out->target[t] = first + t;
+
+   for (i = 0; i < s->lanes; i++)
+   {
+      int max;
+
+      if (!s->done[i])
+         continue;
+
+      max = board_max_exponent(s->board[i]);
+
+      for (t = 0; t < STATS_TARGETS; t++)
+         if (max >= out->target[t])
+            reached[t]++;
+
+      score += s->score[i];
+      out->done++;
+   }
+
+   for (t = 0; t < STATS_TARGETS; t++)
+      out->reach[t] = out->done ? (float)reached[t] / out->done : 0;
+
+   out->mean_score = out->done ? score / out->done : 0;
+}
@@ -0,0 +1,70 @@
+#ifndef _GAME_STATS_H
+#define _GAME_STATS_H
+
+#include <stdint.h>
+#include <boolean.h>
+
+#include "game_board.h"
+#include "game_rng.h"
+
+/* Monte Carlo rollouts from one position. Every rollout is a lane of a
+ * batch kept in structure-of-arrays form, and all live lanes advance
+ * together one move at a time, so a batch can be stepped a few moves
+ * per frame and split across the pool in slices of STATS_SLICE lanes.
+ * Lanes only depend on their own RNG, the outcome does not depend on
+ * the number of threads. */
+
+#define STATS_MAX_ROLLOUTS 1024
+#define STATS_SLICE        64
+
+/* tiles whose reach probability is reported, the ones doubling the
+ * largest tile of the position up to three times */
+#define STATS_TARGETS      3
+
+typedef enum
+{
+   STATS_POLICY_RANDOM,
+   STATS_POLICY_GREEDY
+} stats_policy_t;
+
+typedef struct
+{
+   /* finished and requested rollouts */
+   int done;
+   int rollouts;
+   /* exponent of each target tile and the share of finished rollouts
+    * that reached it */
+   int target[STATS_TARGETS];
+   float reach[STATS_TARGETS];
+   double mean_score;
+} stats_t;
+
+typedef struct
+{
+   board_t board[STATS_MAX_ROLLOUTS];
+   int64_t score[STATS_MAX_ROLLOUTS];
+   rng_t rng[STATS_MAX_ROLLOUTS];
+   uint8_t done[STATS_MAX_ROLLOUTS];
+
+   /* the position every lane started from */
+   board_t start;
+   int64_t start_score;
+   int lanes;
+   stats_policy_t policy;
+   /* moves played so far, a rollout ends after max_moves */
+   int moves;
+   int max_moves;
+} stats_batch_t;
+
+/* Sets up 'rollouts' lanes (at most STATS_MAX_ROLLOUTS) from 'b', each
+ * cut off after 'max_moves' moves. */
+void stats_start(stats_batch_t *s, board_t b, int64_t score, uint64_t seed,
+      int rollouts, int max_moves, stats_policy_t policy);
+
+/* Plays up to 'moves' more moves on every live lane. Returns true once
+ * every rollout is over. */
+bool stats_step(stats_batch_t *s, int moves);
+
+void stats_result(const stats_batch_t *s, stats_t *out);
+
+#endif
@@ -0,0 +1,209 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <streams/file_stream.h>
+
+#include "game_tb.h"
+
+/* the header is part of the file format */
+typedef char tb_header_check[sizeof(tb_header_t) == TB_HEADER_SIZE ? 1 : -1];
+
+uint64_t tb_entries(int goal)
+{
+   int i;
+   uint64_t entries = 1;
+
+   if (goal < 2 || goal > BOARD_MAX_EXPONENT)
+      return 0;
+
+   for (i = 0; i < GRID_SIZE; i++)
+   {
+      entries *= (uint64_t)goal;
+      if (entries > TB_MAX_ENTRIES)
+         return 0;
+   }
+
+   return entries;
+}
+
+static void tb_setup(tb_t *tb, int goal)
+{
+   memset(tb, 0, sizeof(*tb));
+
+   tb->header.magic   = TB_MAGIC;
+   tb->header.version = TB_VERSION;
+   tb->header.width   = GRID_WIDTH;
+   tb->header.height  = GRID_HEIGHT;
+   tb->header.goal    = (uint8_t)goal;
+   tb->header.entries = tb_entries(goal);
+}
+
+/* Points the values into 'data' after checking the header. */
+static bool tb_attach(tb_t *tb, const uint8_t *data, size_t size)
+{
+   const tb_header_t *header = (const tb_header_t *)data;
+
+   if (size < TB_HEADER_SIZE ||
+       header->magic   != TB_MAGIC ||
+       header->version != TB_VERSION ||
+       header->width   != GRID_WIDTH ||
+       header->height  != GRID_HEIGHT ||
+       !header->entries ||
+       header->entries != tb_entries(header->goal) ||
+       (size - TB_HEADER_SIZE) / sizeof(float) != header->entries ||
+       (size - TB_HEADER_SIZE) % sizeof(float))
+      return false;
+
+   tb->header = *header;
+   tb->value  = (float *)(data + TB_HEADER_SIZE);
+   return true;
+}
+
+bool tb_alloc(tb_t *tb, int goal)
+{
+   uint64_t bytes;
+
+   tb_setup(tb, goal);
+
+   bytes = TB_HEADER_SIZE + tb->header.entries * sizeof(float);
+   if (!tb->header.entries || bytes != (size_t)bytes)
+      return false;
+
+   /* same layout as a file, header included */
+   if (!(tb->heap = calloc((size_t)bytes, 1)))
+      return false;
+
+   memcpy(tb->heap, &tb->header, TB_HEADER_SIZE);
+   return tb_attach(tb, (const uint8_t *)tb->heap, (size_t)bytes);
+}
+
+bool tb_load(tb_t *tb, const char *path)
+{
+   void *buf   = NULL;
+   int64_t len = 0;
+
+   tb_setup(tb, 0);
+
+   if ((tb->map = game_map_file(path)))
+   {
+      if (tb_attach(tb, (const uint8_t *)game_map_data(tb->map),
+               game_map_size(tb->map)))
+         return true;
+   }
+   else if (filestream_read_file(path, &buf, &len) && buf)
+   {
+      tb->heap = buf;
+
+      if (tb_attach(tb, (const uint8_t *)buf, (size_t)len))
+         return true;
+   }
+
+   tb_free(tb);
+   return false;
+}
+
+void tb_free(tb_t *tb)
+{
+   game_unmap_file(tb->map);
+   free(tb->heap);
+   tb_setup(tb, 0);
+}
+
+bool tb_covers(const tb_t *tb, board_t b)
+{
+   return tb->value && board_max_exponent(b) < tb->header.goal;
+}
+
+size_t tb_index(const tb_t *tb, board_t b)
+{
+   int i;
+   size_t index = 0;
+
+   for (i = GRID_SIZE - 1; i >= 0; i--)
+      index = index * tb->header.goal + (size_t)board_get(b, i);
+
+   return index;
+}
+
+/* Chance from a position with the player to move. */
+static float tb_position(const tb_t *tb, board_t b)
+{
+   if (board_max_exponent(b) >= tb->header.goal)
+      return 1;
+
+   return tb->value[tb_index(tb, b)];
+}
+
+float tb_afterstate(const tb_t *tb, board_t b)
+{
+   int i, empty = 0;
+   float sum = 0;
+
+   if (board_max_exponent(b) >= tb->header.goal)
+      return 1;
+
+   for (i = 0; i < GRID_SIZE; i++)
+   {
+      board_t two, four;
+
+      if (board_get(b, i))
+         continue;
+
+      two  = b;
+      four = b;
+      board_set(two, i, 1);
+      board_set(four, i, 2);
+
+      sum += 0.9f * tb_position(tb, two) + 0.1f * tb_position(tb, four);
+      empty++;
+   }
+
+   /* a move that changed the board always leaves a cell free */
+   return empty ? sum / empty : 0;
+}
+
+direction_t tb_best_move(const tb_t *tb, board_t b)
+{
+   int dir;
+   float best = 0;
+   direction_t best_dir = DIR_NONE;
+
+   if (!tb_covers(tb, b))
+      return DIR_NONE;
+
+   for (dir = DIR_UP; dir <= DIR_LEFT; dir++)
+   {
+      float value;
+      board_t moved = board_move(b, (direction_t)dir, NULL);
+
+      if (board_equal(moved, b))
+         continue;
+
+      value = tb_afterstate(tb, moved);
+
+      if (best_dir == DIR_NONE || value > best)
+      {
+         best     = value;
+         best_dir = (direction_t)dir;
+      }
+   }
+
+   /* no move can reach the goal any more, leave it to the search */
+   return best > 0 ? best_dir : DIR_NONE;
+}
+
+bool tb_save(const tb_t *tb, const char *path)
+{
+   bool ok;
+   int64_t size = (int64_t)(tb->header.entries * sizeof(float));
+   RFILE *file  = filestream_open(path, RETRO_VFS_FILE_ACCESS_WRITE,
+         RETRO_VFS_FILE_ACCESS_HINT_NONE);
+
+   if (!file)
+      return false;
+
+   ok = filestream_write(file, &tb->header, TB_HEADER_SIZE) == TB_HEADER_SIZE &&
+        filestream_write(file, tb->value, size) == size;
+
+   return filestream_close(file) == 0 && ok;
+}
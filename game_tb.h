@@ -0,0 +1,81 @@
+#ifndef _GAME_TB_H
+#define _GAME_TB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <boolean.h>
+
+#include "game.h"
+#include "game_board.h"
+#include "game_mmap.h"
+
+/* Endgame tablebase: the exact chance of building the goal tile from
+ * every position whose tiles are all below it, with a 2 spawning nine
+ * times out of ten and best play. A position is covered when none of
+ * its tiles has reached the goal yet.
+ *
+ * Tablebase file: a tb_header_t, then one native float per position,
+ * indexed by the cell exponents read as the digits of a base 'goal'
+ * number, cell 0 lowest. The values start 64-byte aligned, so a mapped
+ * file is used in place. 2048_tbgen writes it; the dense index only
+ * fits small boards, a 3x3 board up to 512 takes 1.5GB. */
+
+#define TB_MAGIC        0x53414254u /* "TBAS" when little endian */
+#define TB_VERSION      1
+#define TB_HEADER_SIZE  64
+
+/* entries a table may have, past that the index is too sparse to pay */
+#define TB_MAX_ENTRIES  ((uint64_t)1 << 32)
+
+typedef struct
+{
+   uint32_t magic;
+   uint32_t version;
+   uint8_t width;
+   uint8_t height;
+   /* exponent of the goal tile, also the radix of the index */
+   uint8_t goal;
+   uint8_t reserved;
+   uint32_t reserved2;
+   uint64_t entries;
+   uint8_t padding[TB_HEADER_SIZE - 24];
+} tb_header_t;
+
+typedef struct
+{
+   tb_header_t header;
+   float *value;
+
+   /* where the values live, one of the two */
+   game_map_t *map;
+   void *heap;
+} tb_t;
+
+/* Number of positions a table for 'goal' holds, 0 when it would be
+ * past TB_MAX_ENTRIES. */
+uint64_t tb_entries(int goal);
+
+/* Sets up an empty table for 'goal', every value at 0. */
+bool tb_alloc(tb_t *tb, int goal);
+
+/* Loads a tablebase made for this board size, mapped where the
+ * platform allows and read into memory otherwise. */
+bool tb_load(tb_t *tb, const char *path);
+void tb_free(tb_t *tb);
+
+bool tb_covers(const tb_t *tb, board_t b);
+size_t tb_index(const tb_t *tb, board_t b);
+
+/* Chance of reaching the goal from the position after a move, before
+ * the spawn. 1 once the move built the goal tile. */
+float tb_afterstate(const tb_t *tb, board_t b);
+
+/* Move with the best chance of reaching the goal. DIR_NONE when the
+ * position is not covered or no move can reach the goal any more, so
+ * the caller is left to search. */
+direction_t tb_best_move(const tb_t *tb, board_t b);
+
+/* Writes the table in the tablebase file format. */
+bool tb_save(const tb_t *tb, const char *path);
+
+#endif
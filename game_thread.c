@@ -0,0 +1,237 @@
+#include <stdlib.h>
+
+#include "game_thread.h"
+
+#ifdef HAVE_GAME_THREADS
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+struct game_thread
+{
+#ifdef _WIN32
+   HANDLE handle;
+#else
+   pthread_t id;
+#endif
+   void (*fn)(void *);
+   void *arg;
+};
+
+struct game_mutex
+{
+#ifdef _WIN32
+   CRITICAL_SECTION cs;
+#else
+   pthread_mutex_t id;
+#endif
+};
+
+struct game_cond
+{
+#ifdef _WIN32
+   CONDITION_VARIABLE cv;
+#else
+   pthread_cond_t id;
+#endif
+};
+
+#ifdef _WIN32
+static DWORD WINAPI thread_wrap(void *data)
+#else
+static void *thread_wrap(void *data)
+#endif
+{
+   game_thread_t *thread = (game_thread_t *)data;
+
+   thread->fn(thread->arg);
+   return 0;
+}
+
+game_thread_t *game_thread_create(void (*fn)(void *), void *arg)
+{
+   game_thread_t *thread = (game_thread_t *)calloc(1, sizeof(*thread));
+
+   if (!thread)
+      return NULL;
+
+   thread->fn  = fn;
+   thread->arg = arg;
+
+#ifdef _WIN32
+   thread->handle = CreateThread(NULL, 0, thread_wrap, thread, 0, NULL);
+   if (!thread->handle)
+#else
+   if (pthread_create(&thread->id, NULL, thread_wrap, thread) != 0)
+#endif
+   {
+      free(thread);
+      return NULL;
+   }
+
+   return thread;
+}
+
+void game_thread_join(game_thread_t *thread)
+{
+   if (!thread)
+      return;
+
+#ifdef _WIN32
+   WaitForSingleObject(thread->handle, INFINITE);
+   CloseHandle(thread->handle);
+#else
+   pthread_join(thread->id, NULL);
+#endif
+
+   free(thread);
+}
+
+game_mutex_t *game_mutex_create(void)
+{
+   game_mutex_t *mutex = (game_mutex_t *)calloc(1, sizeof(*mutex));
+
+   if (!mutex)
+      return NULL;
+
+#ifdef _WIN32
+   InitializeCriticalSection(&mutex->cs);
+#else
+   if (pthread_mutex_init(&mutex->id, NULL) != 0)
+   {
+      free(mutex);
+      return NULL;
+   }
+#endif
+
+   return mutex;
+}
+
+void game_mutex_free(game_mutex_t *mutex)
+{
+   if (!mutex)
+      return;
+
+#ifdef _WIN32
+   DeleteCriticalSection(&mutex->cs);
+#else
+   pthread_mutex_destroy(&mutex->id);
+#endif
+
+   free(mutex);
+}
+
+void game_mutex_lock(game_mutex_t *mutex)
+{
+#ifdef _WIN32
+   EnterCriticalSection(&mutex->cs);
+#else
+   pthread_mutex_lock(&mutex->id);
+#endif
+}
+
+bool game_mutex_trylock(game_mutex_t *mutex)
+{
+#ifdef _WIN32
+   return TryEnterCriticalSection(&mutex->cs) != 0;
+#else
+   return pthread_mutex_trylock(&mutex->id) == 0;
+#endif
+}
+
+void game_mutex_unlock(game_mutex_t *mutex)
+{
+#ifdef _WIN32
+   LeaveCriticalSection(&mutex->cs);
+#else
+   pthread_mutex_unlock(&mutex->id);
+#endif
+}
+
+game_cond_t *game_cond_create(void)
+{
+   game_cond_t *cond = (game_cond_t *)calloc(1, sizeof(*cond));
+
+   if (!cond)
+      return NULL;
+
+#ifdef _WIN32
+   InitializeConditionVariable(&cond->cv);
+#else
+   if (pthread_cond_init(&cond->id, NULL) != 0)
+   {
+      free(cond);
+      return NULL;
+   }
+#endif
+
+   return cond;
+}
+
+void game_cond_free(game_cond_t *cond)
+{
+   if (!cond)
+      return;
+
+#ifndef _WIN32
+   pthread_cond_destroy(&cond->id);
+#endif
+
+   free(cond);
+}
+
+void game_cond_wait(game_cond_t *cond, game_mutex_t *mutex)
+{
+#ifdef _WIN32
+   SleepConditionVariableCS(&cond->cv, &mutex->cs, INFINITE);
+#else
+   pthread_cond_wait(&cond->id, &mutex->id);
+#endif
+}
+
+void game_cond_signal(game_cond_t *cond)
+{
+#ifdef _WIN32
+   WakeConditionVariable(&cond->cv);
+#else
+   pthread_cond_signal(&cond->id);
+#endif
+}
+
+void game_cond_broadcast(game_cond_t *cond)
+{
+#ifdef _WIN32
+   WakeAllConditionVariable(&cond->cv);
+#else
+   pthread_cond_broadcast(&cond->id);
+#endif
+}
+
+int game_cpu_count(void)
+{
+#if defined(_WIN32)
+   SYSTEM_INFO info;
+
+   GetSystemInfo(&info);
+   return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#elif defined(_SC_NPROCESSORS_ONLN)
+   long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+   return count > 0 ? (int)count : 1;
+#else
+   return 1;
+#endif
+}
+
+#else
+
+int game_cpu_count(void)
+{
+   return 1;
+}
+
+#endif
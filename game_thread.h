@@ -0,0 +1,35 @@
+#ifndef _GAME_THREAD_H
+#define _GAME_THREAD_H
+
+#include <boolean.h>
+
+/* Minimal threading layer, only available in HAVE_GAME_THREADS builds.
+ * Everything that uses it has a serial fallback. */
+
+#ifdef HAVE_GAME_THREADS
+
+typedef struct game_thread game_thread_t;
+typedef struct game_mutex  game_mutex_t;
+typedef struct game_cond   game_cond_t;
+
+game_thread_t *game_thread_create(void (*fn)(void *), void *arg);
+void game_thread_join(game_thread_t *thread);
+
+game_mutex_t *game_mutex_create(void);
+void game_mutex_free(game_mutex_t *mutex);
+void game_mutex_lock(game_mutex_t *mutex);
+bool game_mutex_trylock(game_mutex_t *mutex);
+void game_mutex_unlock(game_mutex_t *mutex);
+
+game_cond_t *game_cond_create(void);
+void game_cond_free(game_cond_t *cond);
+void game_cond_wait(game_cond_t *cond, game_mutex_t *mutex);
+void game_cond_signal(game_cond_t *cond);
+void game_cond_broadcast(game_cond_t *cond);
+
+#endif
+
+/* Number of online CPUs, 1 if unknown or without HAVE_GAME_THREADS. */
+int game_cpu_count(void);
+
+#endif
@@ -0,0 +1,192 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game_tt.h"
+
+#define TT_CACHE_LINE     64
+#define TT_BUCKET_ENTRIES 4
+
+/* data word layout */
+#define TT_DEPTH_SHIFT    32
+#define TT_GEN_SHIFT      40
+#define TT_VALID          ((uint64_t)1 << 48)
+
+/* The hash is stored xor'ed with the data word, so an entry torn by a
+ * concurrent write simply fails to match. */
+typedef struct
+{
+   uint64_t check;
+   uint64_t data;
+} tt_entry_t;
+
+typedef struct
+{
+   tt_entry_t entry[TT_BUCKET_ENTRIES];
+} tt_bucket_t;
+
+static uint64_t zobrist[GRID_SIZE][BOARD_MAX_EXPONENT + 1];
+static bool zobrist_ready = false;
+
+static void *tt_mem = NULL;
+static tt_bucket_t *tt_buckets = NULL;
+static uint64_t tt_mask = 0;
+static unsigned tt_generation = 0;
+
+static uint64_t splitmix64(uint64_t *x)
+{
+   uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+
+   z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+   z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+   return z ^ (z >> 31);
+}
+
+static void init_zobrist(void)
+{
+   int i, v;
+   uint64_t seed = 2048;
+
+   if (zobrist_ready)
+      return;
+
+   for (i = 0; i < GRID_SIZE; i++)
+      for (v = 0; v <= BOARD_MAX_EXPONENT; v++)
+         zobrist[i][v] = v ? splitmix64(&seed) : 0;
+
+   zobrist_ready = true;
+}
+
+bool tt_init(size_t bytes)
+{
+   size_t buckets = 1;
+
+   init_zobrist();
+   tt_deinit();
+
+   if (bytes < sizeof(tt_bucket_t))
+      return true;
+
+   while (buckets * 2 * sizeof(tt_bucket_t) <= bytes)
+      buckets *= 2;
+
+   tt_mem = calloc(buckets * sizeof(tt_bucket_t) + TT_CACHE_LINE, 1);
+
+   if (!tt_mem)
+      return false;
+
+   tt_buckets = (tt_bucket_t *)(((uintptr_t)tt_mem + TT_CACHE_LINE - 1) &
+         ~(uintptr_t)(TT_CACHE_LINE - 1));
+   tt_mask    = buckets - 1;
+
+   return true;
+}
+
+void tt_deinit(void)
+{
+   if (tt_mem)
+      free(tt_mem);
+
+   tt_mem     = NULL;
+   tt_buckets = NULL;
+   tt_mask    = 0;
+}
+
+bool tt_enabled(void)
+{
+   return tt_buckets != NULL;
+}
+
+void tt_new_search(void)
+{
+   tt_generation = (tt_generation + 1) & 0xff;
+}
+
+uint64_t tt_hash(board_t b)
+{
+   int i;
+   uint64_t h = 0;
+
+   for (i = 0; i < GRID_SIZE; i++)
+      h ^= zobrist[i][board_get(b, i)];
+
+   return h;
+}
+
+bool tt_probe(uint64_t hash, int depth, float *value)
+{
+   int i;
+   tt_bucket_t *bucket;
+
+   if (!tt_buckets)
+      return false;
+
+   bucket = &tt_buckets[hash & tt_mask];
+
+   for (i = 0; i < TT_BUCKET_ENTRIES; i++)
+   {
+      uint64_t data = bucket->entry[i].data;
+      uint32_t bits;
+
+      if ((bucket->entry[i].check ^ data) != hash || !(data & TT_VALID) ||
+            (int)((data >> TT_DEPTH_SHIFT) & 0xff) != depth)
+         continue;
+
+      bits = (uint32_t)data;
+      memcpy(value, &bits, sizeof(*value));
+      return true;
+   }
+
+   return false;
+}
+
+/* lower is a better victim: stale entries first, then shallow ones */
+static int entry_worth(uint64_t data)
+{
+   int worth;
+
+   if (!(data & TT_VALID))
+      return -1;
+
+   worth = (int)((data >> TT_DEPTH_SHIFT) & 0xff);
+
+   if (((data >> TT_GEN_SHIFT) & 0xff) == tt_generation)
+      worth += 256;
+
+   return worth;
+}
+
+void tt_store(uint64_t hash, int depth, float value)
+{
+   int i, victim = 0;
+   uint32_t bits;
+   uint64_t data;
+   tt_bucket_t *bucket;
+
+   if (!tt_buckets)
+      return;
+
+   bucket = &tt_buckets[hash & tt_mask];
+
+   for (i = 0; i < TT_BUCKET_ENTRIES; i++)
+   {
+      uint64_t old = bucket->entry[i].data;
+
+      if ((bucket->entry[i].check ^ old) == hash &&
+            (int)((old >> TT_DEPTH_SHIFT) & 0xff) == depth)
+      {
+         victim = i;
+         break;
+      }
+
+      if (entry_worth(old) < entry_worth(bucket->entry[victim].data))
+         victim = i;
+   }
+
+   memcpy(&bits, &value, sizeof(bits));
+   data = bits | ((uint64_t)(depth & 0xff) << TT_DEPTH_SHIFT) |
+          ((uint64_t)tt_generation << TT_GEN_SHIFT) | TT_VALID;
+
+   bucket->entry[victim].data  = data;
+   bucket->entry[victim].check = hash ^ data;
+}
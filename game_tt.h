@@ -0,0 +1,27 @@
+#ifndef _GAME_TT_H
+#define _GAME_TT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <boolean.h>
+
+#include "game_board.h"
+
+/* Transposition table for the AI search: Zobrist hashed, one 64-byte
+ * cache line per bucket, depth-preferred replacement. Values are only
+ * returned for an exact depth match, so a hit gives the same value the
+ * search would have computed. */
+
+/* (Re)allocates the table to fit in 'bytes', 0 disables it. */
+bool tt_init(size_t bytes);
+void tt_deinit(void);
+bool tt_enabled(void);
+
+/* Ages the current entries, call once per root search. */
+void tt_new_search(void);
+
+uint64_t tt_hash(board_t b);
+bool tt_probe(uint64_t hash, int depth, float *value);
+void tt_store(uint64_t hash, int depth, float value);
+
+#endif
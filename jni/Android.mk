@@ -4,7 +4,11 @@ CORE_DIR := $(LOCAL_PATH)/..
 
 include $(CORE_DIR)/Makefile.common
 
-COREFLAGS := -std=gnu99 -DINLINE=inline -D__LIBRETRO__ $(INCFLAGS)
+COREFLAGS := -std=gnu99 -DINLINE=inline -D__LIBRETRO__ -DHAVE_GAME_THREADS -DHAVE_GAME_MMAP $(INCFLAGS)
+
+ifneq ($(GRID),)
+	COREFLAGS += -DGRID_DIM=$(GRID)
+endif
 
 GIT_VERSION := " $(shell git rev-parse --short HEAD || echo unknown)"
 ifneq ($(GIT_VERSION)," unknown")
@@ -1,4 +1,5 @@
 #include "game.h"
+#include "game_replay.h"
 
 #include <stdint.h>
 #include <string.h>
@@ -22,7 +23,22 @@ retro_environment_t environ_cb;
 static retro_input_poll_t input_poll_cb;
 static retro_input_state_t input_state_cb;
 
-#define SAVE_FILE_NAME "2048.srm"
+#define STRINGIFY(x)  #x
+#define XSTRINGIFY(x) STRINGIFY(x)
+
+#if GRID_DIM == 4
+#define CORE_NAME "2048"
+#else
+#define CORE_NAME "2048_" XSTRINGIFY(GRID_DIM) "x" XSTRINGIFY(GRID_DIM)
+#endif
+
+#define SAVE_FILE_NAME CORE_NAME ".srm"
+#define REPLAY_FILE_NAME CORE_NAME ".replay"
+#define WEIGHTS_FILE_NAME CORE_NAME "_ntuple.bin"
+/* a full table only fits in memory for 3x3 boards */
+#if GRID_DIM == 3
+#define TABLEBASE_FILE_NAME CORE_NAME "_tablebase.bin"
+#endif
 
 static float frame_time        = 0;
 static int game_fps            = 60;
@@ -34,11 +50,18 @@ static bool use_sram_file      = false;
 static bool block_sram_write   = false;
 static void *game_data_scratch = NULL;
 
+static RFILE *replay_file      = NULL;
+static bool ai_weights         = false;
+#ifdef TABLEBASE_FILE_NAME
+static bool ai_tablebase       = false;
+#endif
+
 static bool libretro_supports_bitmasks = false;
 bool libretro_supports_sw_fb    = false;
 bool libretro_sw_fb_checked     = false;
 
 static struct retro_frame_time_callback frame_cb;
+static struct retro_perf_callback perf_cb;
 
 bool dark_theme = false;
 
@@ -156,6 +179,142 @@ static void write_save_file(void)
       log_2048(RETRO_LOG_WARN, "Unable to save game data - save directory not set.\n");
 }
 
+static void write_replay(const void *data, size_t size)
+{
+   if (replay_file)
+      filestream_write(replay_file, data, size);
+}
+
+static void open_replay_file(void)
+{
+   char *save_dir = NULL;
+   char replay_path[1024];
+
+   if (replay_file)
+      return;
+
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY, &save_dir) ||
+       !save_dir)
+   {
+      log_2048(RETRO_LOG_WARN, "Unable to record replays - save directory not set.\n");
+      return;
+   }
+
+   replay_path[0] = '\0';
+   fill_pathname_join(replay_path, save_dir,
+         REPLAY_FILE_NAME, sizeof(replay_path));
+
+   /* games are appended to whatever was recorded before */
+   if (path_is_valid(replay_path))
+   {
+      replay_file = filestream_open(replay_path,
+            RETRO_VFS_FILE_ACCESS_READ_WRITE | RETRO_VFS_FILE_ACCESS_UPDATE_EXISTING,
+            RETRO_VFS_FILE_ACCESS_HINT_NONE);
+      if (replay_file)
+         filestream_seek(replay_file, 0, RETRO_VFS_SEEK_POSITION_END);
+   }
+   else
+   {
+      replay_file = filestream_open(replay_path,
+            RETRO_VFS_FILE_ACCESS_WRITE,
+            RETRO_VFS_FILE_ACCESS_HINT_NONE);
+      if (replay_file)
+      {
+         uint8_t header[REPLAY_HEADER_SIZE];
+         filestream_write(replay_file, header, replay_put_header(header));
+      }
+   }
+
+   if (!replay_file)
+   {
+      log_2048(RETRO_LOG_ERROR, "Failed to open replay file: %s\n", replay_path);
+      return;
+   }
+
+   log_2048(RETRO_LOG_INFO, "Recording replays to: %s\n", replay_path);
+   game_set_replay_sink(write_replay);
+}
+
+static void close_replay_file(void)
+{
+   game_set_replay_sink(NULL);
+
+   if (replay_file)
+      filestream_close(replay_file);
+   replay_file = NULL;
+}
+
+/* Path of a file in the system directory, false when there is none. */
+static bool system_file_path(const char *name, char *path, size_t size)
+{
+   char *system_dir = NULL;
+
+   if (!environ_cb(RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY, &system_dir) ||
+       !system_dir)
+      return false;
+
+   path[0] = '\0';
+   fill_pathname_join(path, system_dir, name, size);
+   return true;
+}
+
+static void load_ai_weights(bool enable)
+{
+   char weights_path[1024];
+
+   if (enable == ai_weights)
+      return;
+
+   ai_weights = enable;
+
+   if (!enable)
+   {
+      game_set_ai_weights(NULL);
+      return;
+   }
+
+   if (!system_file_path(WEIGHTS_FILE_NAME, weights_path, sizeof(weights_path)))
+   {
+      log_2048(RETRO_LOG_WARN, "Unable to load AI weights - system directory not set.\n");
+      return;
+   }
+
+   if (game_set_ai_weights(weights_path))
+      log_2048(RETRO_LOG_INFO, "Loaded AI weights: %s\n", weights_path);
+   else
+      log_2048(RETRO_LOG_ERROR, "Failed to load AI weights, using the heuristic: %s\n",
+            weights_path);
+}
+
+#ifdef TABLEBASE_FILE_NAME
+static void load_ai_tablebase(bool enable)
+{
+   char tablebase_path[1024];
+
+   if (enable == ai_tablebase)
+      return;
+
+   ai_tablebase = enable;
+
+   if (!enable)
+   {
+      game_set_ai_tablebase(NULL);
+      return;
+   }
+
+   if (!system_file_path(TABLEBASE_FILE_NAME, tablebase_path, sizeof(tablebase_path)))
+   {
+      log_2048(RETRO_LOG_WARN, "Unable to load AI tablebase - system directory not set.\n");
+      return;
+   }
+
+   if (game_set_ai_tablebase(tablebase_path))
+      log_2048(RETRO_LOG_INFO, "Loaded AI tablebase: %s\n", tablebase_path);
+   else
+      log_2048(RETRO_LOG_ERROR, "Failed to load AI tablebase: %s\n", tablebase_path);
+}
+#endif
+
 void retro_init(void)
 {
    struct retro_log_callback logging;
@@ -177,6 +336,12 @@ void retro_init(void)
    if (environ_cb(RETRO_ENVIRONMENT_GET_LOG_INTERFACE, &logging))
       log_cb = logging.log;
 
+   memset(&perf_cb, 0, sizeof(perf_cb));
+   if (environ_cb(RETRO_ENVIRONMENT_GET_PERF_INTERFACE, &perf_cb))
+      game_set_clock(perf_cb.get_time_usec);
+   else
+      game_set_clock(NULL);
+
    game_calculate_pitch();
 
    game_init();
@@ -188,6 +353,11 @@ void retro_deinit(void)
       write_save_file();
 
    game_deinit();
+   close_replay_file();
+   ai_weights = false;
+#ifdef TABLEBASE_FILE_NAME
+   ai_tablebase = false;
+#endif
 
    frame_time        = 0;
    first_run         = true;
@@ -218,7 +388,7 @@ void retro_set_controller_port_device(unsigned port, unsigned device)
 void retro_get_system_info(struct retro_system_info *info)
 {
    memset(info, 0, sizeof(*info));
-   info->library_name     = "2048";
+   info->library_name     = CORE_NAME;
 #ifndef GIT_VERSION
 #define GIT_VERSION ""
 #endif
@@ -244,6 +414,46 @@ static void frame_time_cb(retro_usec_t usec)
    frame_time = usec / 1000000.0;
 }
 
+/* Options that take effect while running, re-read whenever the
+ * frontend reports a change. */
+static void check_live_variables(void)
+{
+   struct retro_variable var = {0};
+
+   var.key = "2048_autoplay";
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      game_set_autoplay(!strcmp(var.value, "On"));
+
+   var.key = "2048_ai_memory";
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      game_set_ai_memory((size_t)atoi(var.value) << 20);
+
+   var.key = "2048_ai_eval";
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      load_ai_weights(!strcmp(var.value, "N-tuple network"));
+
+#ifdef TABLEBASE_FILE_NAME
+   var.key = "2048_ai_tablebase";
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      load_ai_tablebase(!strcmp(var.value, "On"));
+#endif
+
+   var.key = "2048_seed";
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      game_set_seed(strcmp(var.value, "Random") != 0,
+            (uint64_t)atoi(var.value));
+
+   var.key = "2048_replay";
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      if (!strcmp(var.value, "On"))
+         open_replay_file();
+      else
+         close_replay_file();
+   }
+}
+
+/* All options, theme and framerate only apply on (re)start. */
 static void check_variables(void)
 {
    struct retro_variable var        = {0};
@@ -268,8 +478,11 @@ static void check_variables(void)
          frame_cb.callback  = frame_time_cb;
          frame_cb.reference = 1000000 / game_fps;
          environ_cb(RETRO_ENVIRONMENT_SET_FRAME_TIME_CALLBACK, &frame_cb);
+         game_set_frame_budget(frame_cb.reference);
       }
    }
+
+   check_live_variables();
 }
 
 void retro_set_environment(retro_environment_t cb)
@@ -280,6 +493,14 @@ void retro_set_environment(retro_environment_t cb)
    static const struct retro_variable vars[] = {
       { "2048_theme", "Theme (restart); Light|Dark" },
       { "2048_fps", "Framerate (restart); 60|72|75|90|100|119|120|144|155|160|165|180|200|240|244|300|320|360|380|400|420|440|460|480|500|520|540|560|580|600" },
+      { "2048_autoplay", "AI autoplay; Off|On" },
+      { "2048_ai_memory", "AI search memory; 16MB|Off|1MB|4MB|64MB|256MB" },
+      { "2048_ai_eval", "AI evaluation; Heuristic|N-tuple network" },
+#ifdef TABLEBASE_FILE_NAME
+      { "2048_ai_tablebase", "AI endgame tablebase; Off|On" },
+#endif
+      { "2048_seed", "Tile seed (new game); Random|1|2|3|4|5|6|7|8|9|10|42|2048" },
+      { "2048_replay", "Record replays; Off|On" },
       { NULL, NULL },
    };
 
@@ -330,6 +551,7 @@ void retro_reset(void)
 void retro_run(void)
 {
    int16_t ret = 0;
+   bool updated = false;
    key_state_t ks;
 
    block_sram_write = false;
@@ -350,8 +572,15 @@ void retro_run(void)
       
       check_variables();
 
+      /* the save data is in place by now */
+      if (!game_check_data())
+         log_2048(RETRO_LOG_ERROR, "Save data is corrupted, starting a new game.\n");
+      game_replay_sync();
+
       first_run = false;
    }
+   else if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &updated) && updated)
+      check_live_variables();
 
    input_poll_cb();
    
@@ -361,7 +590,7 @@ void retro_run(void)
    else
    {
       unsigned i;
-      for (i = 0; i < RETRO_DEVICE_ID_JOYPAD_RIGHT+1; i++)
+      for (i = 0; i < RETRO_DEVICE_ID_JOYPAD_R+1; i++)
       {
          if (input_state_cb(0, RETRO_DEVICE_JOYPAD, 0, i))
             ret |= (1 << i);
@@ -374,6 +603,8 @@ void retro_run(void)
    ks.left   = (ret & (1 << RETRO_DEVICE_ID_JOYPAD_LEFT));
    ks.start  = (ret & (1 << RETRO_DEVICE_ID_JOYPAD_START));
    ks.select = (ret & (1 << RETRO_DEVICE_ID_JOYPAD_SELECT));
+   ks.undo   = (ret & (1 << RETRO_DEVICE_ID_JOYPAD_L));
+   ks.hint   = (ret & (1 << RETRO_DEVICE_ID_JOYPAD_R));
 
    game_update(frame_time, &ks);
    game_render();
@@ -388,6 +619,8 @@ bool retro_load_game(const struct retro_game_info *info)
       { 0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_RIGHT, "Right" },
       { 0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_START, "Start" },
       { 0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_SELECT, "Pause" },
+      { 0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_L,      "Undo" },
+      { 0, RETRO_DEVICE_JOYPAD, 0, RETRO_DEVICE_ID_JOYPAD_R,      "Hint" },
       { 0 },
    };
 
@@ -402,6 +635,7 @@ bool retro_load_game(const struct retro_game_info *info)
    frame_cb.reference = 1000000 / game_fps;
    frame_cb.callback(frame_cb.reference);
    environ_cb(RETRO_ENVIRONMENT_SET_FRAME_TIME_CALLBACK, &frame_cb);
+   game_set_frame_budget(frame_cb.reference);
 
    return true;
 }
@@ -437,6 +671,7 @@ bool retro_serialize(void *data_, size_t size)
       return false;
 
    memcpy(data_, game_data(), game_data_size());
+   game_replay_mark();
    return true;
 }
 
@@ -447,7 +682,10 @@ bool retro_unserialize(const void *data_, size_t size)
    if (size < game_data_size())
       return false;
 
-   memcpy(game_data(), data_, game_data_size());
+   if (!game_load_data(data_))
+      return false;
+
+   game_replay_sync();
    return true;
 }
 
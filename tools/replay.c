@@ -0,0 +1,107 @@
+/* Replay playback.
+ *
+ * Feeds a recorded replay stream back through the rules engine as fast
+ * as it goes and writes one CSV line per game (index, score, max tile,
+ * moves, undos, status) followed by the throughput on stderr. With -r
+ * the whole stream is played that many times, to benchmark the engine
+ * on real game traces.
+ *
+ *   2048_replay [-r repeats] [-o file] replay
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game_board.h"
+#include "game_replay.h"
+#include "tool_common.h"
+
+int main(int argc, char **argv)
+{
+   long i, repeats   = tool_arg_long(argc, argv, "-r", 1);
+   const char *path  = tool_arg(argc, argv, "-o");
+   const char *input = argc > 1 ? argv[argc - 1] : NULL;
+   FILE *out         = stdout;
+   uint8_t *data;
+   size_t size       = 0;
+   long games        = 0, failed = 0;
+   double total_moves = 0;
+   retro_time_t start, elapsed;
+
+   if (!input || input[0] == '-')
+   {
+      fprintf(stderr, "usage: %s [-r repeats] [-o file] replay\n", argv[0]);
+      return 1;
+   }
+
+   if (!(data = tool_read_file(input, &size)))
+   {
+      fprintf(stderr, "cannot read %s\n", input);
+      return 1;
+   }
+
+   if (path && !(out = fopen(path, "w")))
+   {
+      fprintf(stderr, "cannot open %s\n", path);
+      free(data);
+      return 1;
+   }
+
+   board_init_tables();
+
+   fprintf(out, "game,score,max_tile,moves,undos,status\n");
+
+   start = tool_time_usec();
+
+   for (i = 0; i < repeats; i++)
+   {
+      replay_player_t player;
+      replay_status_t status = replay_open(&player, data, size);
+      long game              = 0;
+
+      if (status != REPLAY_OK)
+      {
+         fprintf(stderr, "%s: %s\n", input, replay_status_string(status));
+         break;
+      }
+
+      while ((status = replay_play_game(&player)) != REPLAY_EOF)
+      {
+         total_moves += player.moves;
+
+         /* only the first pass is listed */
+         if (!i)
+         {
+            fprintf(out, "%ld,%lld,%lld,%u,%u,%s\n", game, (long long)player.score,
+                  (long long)1 << board_max_exponent(player.board), player.moves,
+                  player.undos, replay_status_string(status));
+
+            games++;
+            if (status != REPLAY_OK)
+               failed++;
+         }
+
+         game++;
+
+         if (status != REPLAY_OK && replay_skip_game(&player) != REPLAY_OK)
+            break;
+      }
+   }
+
+   elapsed = tool_time_usec() - start;
+   if (elapsed < 1)
+      elapsed = 1;
+
+   fprintf(stderr, "%ld games (%ld failed), %.0f moves in %.2fs: %.0f moves/s\n",
+         games, failed, total_moves, elapsed / 1e6,
+         total_moves * 1e6 / elapsed);
+
+   free(data);
+
+   if (out != stdout)
+      fclose(out);
+
+   return failed ? 2 : 0;
+}
@@ -0,0 +1,328 @@
+/* Headless self-play simulator.
+ *
+ * Plays a batch of games with one policy on every core and writes one
+ * CSV line per game (index, score, max tile, moves) followed by a
+ * summary on stderr. It fails if a policy ever gave up on a board
+ * that could still move. Games are seeded from the base seed and their
+ * index, so a run is reproducible for any thread count. With -r every
+ * game is also recorded to a replay file, in game order.
+ *
+ *   2048_sim [-n games] [-p random|greedy|expectimax] [-d depth]
+ *            [-s seed] [-t threads] [-m ai_memory_mb] [-o file]
+ *            [-r replay] [-w ntuple_weights] [-b tablebase]
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game_board.h"
+#include "game_rng.h"
+#include "game_replay.h"
+#include "game_ai.h"
+#include "game_pool.h"
+#include "tool_common.h"
+
+#define SIM_CHUNK 4096
+
+typedef enum
+{
+   POLICY_RANDOM,
+   POLICY_GREEDY,
+   POLICY_EXPECTIMAX
+} policy_t;
+
+typedef struct
+{
+   uint64_t seed;
+   policy_t policy;
+   int depth;
+
+   int64_t score;
+   int64_t max_tile;
+   int moves;
+   /* the policy gave up with a move left */
+   bool stuck;
+
+   /* replay of the game, NULL when not recording */
+   uint8_t *replay;
+   size_t replay_len;
+   size_t replay_size;
+} sim_game_t;
+
+static bool record = false;
+
+/* room for one more replay record */
+static uint8_t *sim_reserve(sim_game_t *game)
+{
+   if (game->replay_len + REPLAY_MAX_RECORD > game->replay_size)
+   {
+      size_t size  = game->replay_size ? game->replay_size * 2 : 4096;
+      uint8_t *buf = (uint8_t *)realloc(game->replay, size);
+
+      if (!buf)
+         abort();
+
+      game->replay      = buf;
+      game->replay_size = size;
+   }
+
+   return game->replay + game->replay_len;
+}
+
+/* same draws as add_tile() in the core, so a seed plays the same
+ * spawns here and in the frontend */
+static board_t sim_spawn(board_t b, rng_t *rng, sim_game_t *game)
+{
+   int cell, value, empty = board_count_empty(b);
+
+   if (!empty)
+      return b;
+
+   empty = (int)rng_range(rng, empty);
+   value = rng_range(rng, 10) ? 1 : 2;
+   b     = board_add_tile(b, empty, value, &cell);
+
+   if (record)
+      game->replay_len += replay_put_spawn(sim_reserve(game), cell, value);
+
+   return b;
+}
+
+static direction_t pick_random(board_t b, rng_t *rng)
+{
+   int dir, count = 0;
+   direction_t legal[4];
+
+   for (dir = DIR_UP; dir <= DIR_LEFT; dir++)
+      if (!board_equal(board_move(b, (direction_t)dir, NULL), b))
+         legal[count++] = (direction_t)dir;
+
+   return count ? legal[rng_range(rng, count)] : DIR_NONE;
+}
+
+/* highest immediate score, more free cells on a tie */
+static direction_t pick_greedy(board_t b)
+{
+   int dir, best_empty = -1;
+   int64_t best_score = -1;
+   direction_t best = DIR_NONE;
+
+   for (dir = DIR_UP; dir <= DIR_LEFT; dir++)
+   {
+      int64_t score = 0;
+      int empty;
+      board_t moved = board_move(b, (direction_t)dir, &score);
+
+      if (board_equal(moved, b))
+         continue;
+
+      empty = board_count_empty(moved);
+
+      if (score > best_score || (score == best_score && empty > best_empty))
+      {
+         best       = (direction_t)dir;
+         best_score = score;
+         best_empty = empty;
+      }
+   }
+
+   return best;
+}
+
+static void sim_play(void *data)
+{
+   sim_game_t *game = (sim_game_t *)data;
+   board_t b;
+   rng_t rng, policy_rng;
+
+   /* the random policy has a generator of its own, so the tile RNG
+    * makes the spawns and nothing else, as in the core */
+   rng_seed(&rng, game->seed);
+   rng_seed(&policy_rng, ~game->seed);
+   board_clear(b);
+
+   if (record)
+      game->replay_len += replay_put_start(sim_reserve(game), &rng);
+
+   b = sim_spawn(sim_spawn(b, &rng, game), &rng, game);
+
+   game->score = 0;
+   game->stuck = false;
+   game->moves = 0;
+
+   for (;;)
+   {
+      direction_t dir;
+
+      switch (game->policy)
+      {
+         case POLICY_RANDOM:
+            dir = pick_random(b, &policy_rng);
+            break;
+         case POLICY_GREEDY:
+            dir = pick_greedy(b);
+            break;
+         default:
+            dir = ai_best_move(b, game->depth, 0);
+            break;
+      }
+
+      if (dir == DIR_NONE)
+      {
+         game->stuck = board_can_move(b);
+         break;
+      }
+
+      if (record)
+         game->replay_len += replay_put_move(sim_reserve(game), dir);
+
+      b = sim_spawn(board_move(b, dir, &game->score), &rng, game);
+      game->moves++;
+   }
+
+   if (record)
+      game->replay_len += replay_put_board(sim_reserve(game), REPLAY_OP_END,
+            b, game->score);
+
+   game->max_tile = (int64_t)1 << board_max_exponent(b);
+}
+
+int main(int argc, char **argv)
+{
+   long i, games      = tool_arg_long(argc, argv, "-n", 1000);
+   int depth          = (int)tool_arg_long(argc, argv, "-d", 2);
+   int threads        = (int)tool_arg_long(argc, argv, "-t", 0);
+   long memory        = tool_arg_long(argc, argv, "-m", 64);
+   uint64_t seed      = (uint64_t)tool_arg_long(argc, argv, "-s", 1);
+   const char *policy = tool_arg(argc, argv, "-p");
+   const char *path   = tool_arg(argc, argv, "-o");
+   const char *replay = tool_arg(argc, argv, "-r");
+   const char *ntuple = tool_arg(argc, argv, "-w");
+   const char *tbase  = tool_arg(argc, argv, "-b");
+   FILE *out          = stdout;
+   FILE *replay_out   = NULL;
+   sim_game_t *chunk;
+   policy_t pol       = POLICY_RANDOM;
+   retro_time_t start, elapsed;
+   double total_score = 0, total_moves = 0;
+   long won = 0, stuck = 0;
+
+   if (policy && !strcmp(policy, "greedy"))
+      pol = POLICY_GREEDY;
+   else if (policy && !strcmp(policy, "expectimax"))
+      pol = POLICY_EXPECTIMAX;
+   else if (policy && strcmp(policy, "random"))
+   {
+      fprintf(stderr, "unknown policy: %s\n", policy);
+      return 1;
+   }
+
+   if (path && !(out = fopen(path, "w")))
+   {
+      fprintf(stderr, "cannot open %s\n", path);
+      return 1;
+   }
+
+   if (replay)
+   {
+      uint8_t header[REPLAY_HEADER_SIZE];
+
+      if (!(replay_out = fopen(replay, "wb")))
+      {
+         fprintf(stderr, "cannot open %s\n", replay);
+         return 1;
+      }
+
+      fwrite(header, 1, replay_put_header(header), replay_out);
+      record = true;
+   }
+
+   chunk = (sim_game_t *)calloc(SIM_CHUNK, sizeof(*chunk));
+   if (!chunk)
+      return 1;
+
+   board_init_tables();
+   ai_set_memory((size_t)memory << 20);
+
+   if (ntuple && !ai_load_weights(ntuple))
+   {
+      fprintf(stderr, "cannot load weights from %s\n", ntuple);
+      return 1;
+   }
+
+   if (tbase && !ai_load_tablebase(tbase))
+   {
+      fprintf(stderr, "cannot load tablebase from %s\n", tbase);
+      return 1;
+   }
+
+   ai_init();
+   pool_init(threads);
+
+   fprintf(out, "game,score,max_tile,moves\n");
+
+   start = tool_time_usec();
+
+   for (i = 0; i < games; i += SIM_CHUNK)
+   {
+      long j, count = games - i < SIM_CHUNK ? games - i : SIM_CHUNK;
+
+      for (j = 0; j < count; j++)
+      {
+         chunk[j].seed       = (seed << 32) ^ (uint64_t)(i + j);
+         chunk[j].policy     = pol;
+         chunk[j].depth      = depth;
+         chunk[j].replay_len = 0;
+      }
+
+      pool_run(sim_play, chunk, sizeof(*chunk), (int)count);
+
+      for (j = 0; j < count; j++)
+      {
+         fprintf(out, "%ld,%lld,%lld,%d\n", i + j, (long long)chunk[j].score,
+               (long long)chunk[j].max_tile, chunk[j].moves);
+
+         if (replay_out)
+            fwrite(chunk[j].replay, 1, chunk[j].replay_len, replay_out);
+
+         total_score += chunk[j].score;
+         total_moves += chunk[j].moves;
+         if (chunk[j].max_tile >= 2048)
+            won++;
+         if (chunk[j].stuck)
+            stuck++;
+      }
+   }
+
+   elapsed = tool_time_usec() - start;
+   if (elapsed < 1)
+      elapsed = 1;
+
+   fprintf(stderr, "%ld games on %d threads in %.2fs: %.0f games/s, %.0f moves/s\n",
+         games, pool_threads(), elapsed / 1e6,
+         games * 1e6 / elapsed, total_moves * 1e6 / elapsed);
+
+   if (games > 0)
+      fprintf(stderr, "mean score %.1f, mean moves %.1f, reached 2048 in %.2f%%\n",
+            total_score / games, total_moves / games, won * 100.0 / games);
+
+   if (stuck)
+      fprintf(stderr, "%ld games ended with a move left\n", stuck);
+
+   pool_deinit();
+   ai_deinit();
+
+   for (i = 0; i < SIM_CHUNK; i++)
+      free(chunk[i].replay);
+   free(chunk);
+
+   if (replay_out)
+      fclose(replay_out);
+
+   if (out != stdout)
+      fclose(out);
+
+   return stuck ? 1 : 0;
+}
@@ -0,0 +1,208 @@
+/* Endgame tablebase generator.
+ *
+ * Solves every position whose tiles are all below the goal tile for
+ * the exact chance of building it (see game_tb.h). Moves keep the sum
+ * of the tiles and every spawn adds 2 or 4 to it, so a position only
+ * depends on positions with a larger sum: the solver works back from
+ * the largest sum the table holds, one sum at a time, and all the
+ * positions of one sum are solved in parallel, split on the first two
+ * cells. Prints the chance from a new game at the end.
+ *
+ *   2048_tbgen [-g goal_exponent] [-t threads] -o tablebase
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game_board.h"
+#include "game_tb.h"
+#include "game_pool.h"
+#include "tool_common.h"
+
+typedef struct
+{
+   int first;
+   int second;
+   int64_t sum;
+   uint64_t solved;
+} tbgen_task_t;
+
+static tb_t tb;
+static int goal;
+
+static int64_t tile_sum(int v)
+{
+   return v ? (int64_t)1 << v : 0;
+}
+
+static float solve(board_t b)
+{
+   int dir;
+   float best = 0;
+
+   for (dir = DIR_UP; dir <= DIR_LEFT; dir++)
+   {
+      float value;
+      board_t moved = board_move(b, (direction_t)dir, NULL);
+
+      if (board_equal(moved, b))
+         continue;
+
+      if ((value = tb_afterstate(&tb, moved)) > best)
+         best = value;
+   }
+
+   return best;
+}
+
+/* Fills cells 'cell' and up with tiles adding up to 'left', solving
+ * every position that comes out. */
+static void enumerate(tbgen_task_t *task, board_t b, int cell, int64_t left)
+{
+   int v;
+
+   if (cell == GRID_SIZE)
+   {
+      if (!left)
+      {
+         tb.value[tb_index(&tb, b)] = solve(b);
+         task->solved++;
+      }
+      return;
+   }
+
+   /* the cells left cannot hold that much */
+   if (left > (int64_t)(GRID_SIZE - cell) << (goal - 1))
+      return;
+
+   for (v = 0; v < goal && tile_sum(v) <= left; v++)
+   {
+      board_set(b, cell, v);
+      enumerate(task, b, cell + 1, left - tile_sum(v));
+   }
+}
+
+static void solve_task(void *data)
+{
+   tbgen_task_t *task = (tbgen_task_t *)data;
+   int64_t left = task->sum - tile_sum(task->first) - tile_sum(task->second);
+   board_t b;
+
+   task->solved = 0;
+
+   if (left < 0)
+      return;
+
+   board_clear(b);
+   board_set(b, 0, task->first);
+   board_set(b, 1, task->second);
+   enumerate(task, b, 2, left);
+}
+
+/* Chance from the two tiles a game starts with. */
+static double new_game_chance(void)
+{
+   int i, j, a, c;
+   double sum = 0;
+
+   for (i = 0; i < GRID_SIZE; i++)
+   {
+      for (j = 0; j < GRID_SIZE; j++)
+      {
+         if (i == j)
+            continue;
+
+         for (a = 1; a <= 2; a++)
+         {
+            for (c = 1; c <= 2; c++)
+            {
+               board_t b;
+
+               board_clear(b);
+               board_set(b, i, a);
+               board_set(b, j, c);
+               sum += (a == 1 ? 0.9 : 0.1) * (c == 1 ? 0.9 : 0.1) *
+                      tb.value[tb_index(&tb, b)];
+            }
+         }
+      }
+   }
+
+   return sum / (GRID_SIZE * (GRID_SIZE - 1));
+}
+
+int main(int argc, char **argv)
+{
+   int threads       = (int)tool_arg_long(argc, argv, "-t", 0);
+   const char *path  = tool_arg(argc, argv, "-o");
+   tbgen_task_t *tasks;
+   int64_t sum;
+   uint64_t solved = 0;
+   retro_time_t start;
+
+   goal = (int)tool_arg_long(argc, argv, "-g", 8);
+
+   if (!path)
+   {
+      fprintf(stderr, "usage: %s [-g goal_exponent] [-t threads] -o tablebase\n", argv[0]);
+      return 1;
+   }
+
+   if (goal < 3 || !tb_entries(goal) || goal * goal > POOL_MAX_TASKS)
+   {
+      fprintf(stderr, "no tablebase for %ix%i boards and goal tile %lld\n",
+            GRID_WIDTH, GRID_HEIGHT, (long long)1 << goal);
+      return 1;
+   }
+
+   board_init_tables();
+
+   if (!tb_alloc(&tb, goal) ||
+       !(tasks = (tbgen_task_t *)calloc(goal * goal, sizeof(*tasks))))
+   {
+      fprintf(stderr, "out of memory\n");
+      return 1;
+   }
+
+   pool_init(threads);
+   start = tool_time_usec();
+
+   /* tile sums are even, the largest first */
+   for (sum = (int64_t)GRID_SIZE << (goal - 1); sum >= 0; sum -= 2)
+   {
+      int i;
+
+      for (i = 0; i < goal * goal; i++)
+      {
+         tasks[i].first  = i / goal;
+         tasks[i].second = i % goal;
+         tasks[i].sum    = sum;
+      }
+
+      pool_run(solve_task, tasks, sizeof(*tasks), goal * goal);
+
+      for (i = 0; i < goal * goal; i++)
+         solved += tasks[i].solved;
+   }
+
+   fprintf(stderr, "%llu positions on %d threads in %.2fs\n",
+         (unsigned long long)solved, pool_threads(),
+         (tool_time_usec() - start) / 1e6);
+   fprintf(stderr, "a new game reaches %lld with chance %.6f\n",
+         (long long)1 << goal, new_game_chance());
+
+   pool_deinit();
+
+   if (!tb_save(&tb, path))
+   {
+      fprintf(stderr, "cannot write %s\n", path);
+      return 1;
+   }
+
+   tb_free(&tb);
+   free(tasks);
+
+   return 0;
+}
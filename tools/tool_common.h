@@ -0,0 +1,80 @@
+#ifndef _TOOL_COMMON_H
+#define _TOOL_COMMON_H
+
+/* Helpers shared by the headless tools in this directory. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <libretro.h>
+#include <retro_inline.h>
+
+static retro_time_t RETRO_CALLCONV tool_time_usec(void)
+{
+#ifdef _WIN32
+   LARGE_INTEGER freq, count;
+
+   QueryPerformanceFrequency(&freq);
+   QueryPerformanceCounter(&count);
+   return (retro_time_t)(count.QuadPart * 1000000 / freq.QuadPart);
+#else
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (retro_time_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+/* Returns the value following option 'name' in argv, or NULL. */
+static const char *tool_arg(int argc, char **argv, const char *name)
+{
+   int i;
+
+   for (i = 1; i < argc - 1; i++)
+      if (!strcmp(argv[i], name))
+         return argv[i + 1];
+
+   return NULL;
+}
+
+static long tool_arg_long(int argc, char **argv, const char *name, long def)
+{
+   const char *value = tool_arg(argc, argv, name);
+
+   return value ? strtol(value, NULL, 0) : def;
+}
+
+/* Reads a whole file into a malloc'd buffer, NULL on failure. */
+static INLINE uint8_t *tool_read_file(const char *path, size_t *size)
+{
+   long len;
+   uint8_t *data = NULL;
+   FILE *f       = fopen(path, "rb");
+
+   if (!f)
+      return NULL;
+
+   if (!fseek(f, 0, SEEK_END) && (len = ftell(f)) >= 0 &&
+       !fseek(f, 0, SEEK_SET) && (data = (uint8_t *)malloc(len ? len : 1)))
+   {
+      if (fread(data, 1, len, f) != (size_t)len)
+      {
+         free(data);
+         data = NULL;
+      }
+      *size = (size_t)len;
+   }
+
+   fclose(f);
+   return data;
+}
+
+#endif
@@ -0,0 +1,243 @@
+/* TD(0) self-play trainer for the n-tuple evaluator.
+ *
+ * Every game is played greedily on reward + value of the afterstate,
+ * and after each move the value of the previous afterstate is pulled
+ * towards that of the new one (TD-afterstate learning). All threads
+ * train the one shared network without locks, Hogwild style. A
+ * checkpoint goes out every -c games and at the end, written to a
+ * temporary file first so a reader never sees half a network.
+ *
+ *   2048_train [-n games] [-a alpha] [-s seed] [-t threads]
+ *              [-c checkpoint_games] [-i weights] -o weights
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <streams/file_stream.h>
+
+#include "game_board.h"
+#include "game_rng.h"
+#include "game_ntuple.h"
+#include "game_pool.h"
+#include "tool_common.h"
+
+#define TRAIN_CHUNK 256
+
+typedef struct
+{
+   uint64_t seed;
+
+   int64_t score;
+   int64_t max_tile;
+   int moves;
+} train_game_t;
+
+static ntuple_t net;
+/* learning rate per weight, alpha spread over all lookups */
+static float step;
+
+static board_t train_spawn(board_t b, rng_t *rng)
+{
+   int empty = board_count_empty(b);
+
+   if (!empty)
+      return b;
+
+   empty = (int)rng_range(rng, empty);
+   return board_add_tile(b, empty, rng_range(rng, 10) ? 1 : 2, NULL);
+}
+
+/* Best move on reward + afterstate value, DIR_NONE when stuck. */
+static direction_t train_pick(board_t b, board_t *after, int64_t *reward, float *value)
+{
+   int dir;
+   direction_t best = DIR_NONE;
+
+   for (dir = DIR_UP; dir <= DIR_LEFT; dir++)
+   {
+      int64_t r     = 0;
+      board_t moved = board_move(b, (direction_t)dir, &r);
+      float v;
+
+      if (board_equal(moved, b))
+         continue;
+
+      v = (float)r + ntuple_evaluate(&net, moved);
+
+      if (best == DIR_NONE || v > *value)
+      {
+         best    = (direction_t)dir;
+         *after  = moved;
+         *reward = r;
+         *value  = v;
+      }
+   }
+
+   return best;
+}
+
+static void train_play(void *data)
+{
+   train_game_t *game = (train_game_t *)data;
+   board_t b, after, prev;
+   bool started = false;
+   rng_t rng;
+
+   rng_seed(&rng, game->seed);
+   board_clear(b);
+   board_clear(prev);
+   b = train_spawn(train_spawn(b, &rng), &rng);
+
+   game->score = 0;
+   game->moves = 0;
+
+   for (;;)
+   {
+      int64_t reward;
+      float value;
+
+      if (train_pick(b, &after, &reward, &value) == DIR_NONE)
+         break;
+
+      if (started)
+         ntuple_update(&net, prev, step * (value - ntuple_evaluate(&net, prev)));
+
+      prev    = after;
+      started = true;
+
+      game->score += reward;
+      game->moves++;
+
+      b = train_spawn(after, &rng);
+   }
+
+   /* nothing follows the last afterstate */
+   if (started)
+      ntuple_update(&net, prev, -step * ntuple_evaluate(&net, prev));
+
+   game->max_tile = (int64_t)1 << board_max_exponent(b);
+}
+
+static bool save_checkpoint(const char *path)
+{
+   char tmp[1024];
+
+   snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+   if (!ntuple_save(&net, tmp))
+      return false;
+
+   filestream_delete(path);
+   return filestream_rename(tmp, path) == 0;
+}
+
+int main(int argc, char **argv)
+{
+   long i, games      = tool_arg_long(argc, argv, "-n", 100000);
+   long checkpoint    = tool_arg_long(argc, argv, "-c", 10000);
+   int threads        = (int)tool_arg_long(argc, argv, "-t", 0);
+   uint64_t seed      = (uint64_t)tool_arg_long(argc, argv, "-s", 1);
+   const char *alpha  = tool_arg(argc, argv, "-a");
+   const char *input  = tool_arg(argc, argv, "-i");
+   const char *path   = tool_arg(argc, argv, "-o");
+   train_game_t chunk[TRAIN_CHUNK];
+   retro_time_t start, last;
+   uint64_t first_game;
+   double interval_score = 0;
+   long interval_games = 0, interval_won = 0, next_checkpoint;
+
+   if (!path)
+   {
+      fprintf(stderr, "usage: %s [-n games] [-a alpha] [-s seed] [-t threads]\n"
+            "       [-c checkpoint_games] [-i weights] -o weights\n", argv[0]);
+      return 1;
+   }
+
+   board_init_tables();
+
+   if (!ntuple_alloc(&net))
+   {
+      fprintf(stderr, "out of memory\n");
+      return 1;
+   }
+
+   /* carry on from earlier weights */
+   if (input)
+   {
+      int t;
+      ntuple_t from;
+
+      if (!ntuple_load(&from, input))
+      {
+         fprintf(stderr, "cannot load weights from %s\n", input);
+         return 1;
+      }
+
+      for (t = 0; t < net.tuples; t++)
+         memcpy(net.table[t], from.table[t], net.size[t] * sizeof(float));
+      net.header.games = from.header.games;
+
+      ntuple_free(&from);
+   }
+
+   step = (float)(alpha ? atof(alpha) : 0.1) / (net.tuples * NTUPLE_SYMMETRIES);
+
+   pool_init(threads);
+
+   /* games already behind the weights get new seeds */
+   first_game      = net.header.games;
+   next_checkpoint = checkpoint;
+   start = last    = tool_time_usec();
+
+   for (i = 0; i < games; i += TRAIN_CHUNK)
+   {
+      long j, count = games - i < TRAIN_CHUNK ? games - i : TRAIN_CHUNK;
+
+      for (j = 0; j < count; j++)
+         chunk[j].seed = (seed << 32) ^ (first_game + (uint64_t)(i + j));
+
+      pool_run(train_play, chunk, sizeof(*chunk), (int)count);
+
+      for (j = 0; j < count; j++)
+      {
+         interval_score += chunk[j].score;
+         if (chunk[j].max_tile >= 2048)
+            interval_won++;
+      }
+
+      interval_games   += count;
+      net.header.games += count;
+
+      if (i + count >= next_checkpoint || i + count >= games)
+      {
+         retro_time_t now = tool_time_usec();
+         retro_time_t elapsed = now - last > 0 ? now - last : 1;
+
+         fprintf(stderr, "%llu games, %.0f games/s, mean score %.1f, reached 2048 in %.2f%%\n",
+               (unsigned long long)net.header.games,
+               interval_games * 1e6 / elapsed,
+               interval_score / interval_games,
+               interval_won * 100.0 / interval_games);
+
+         if (!save_checkpoint(path))
+            fprintf(stderr, "cannot write %s\n", path);
+
+         interval_score  = 0;
+         interval_games  = 0;
+         interval_won    = 0;
+         next_checkpoint = i + count + checkpoint;
+         last            = tool_time_usec();
+      }
+   }
+
+   fprintf(stderr, "%ld games on %d threads in %.2fs\n",
+         games, pool_threads(), (tool_time_usec() - start) / 1e6);
+
+   pool_deinit();
+   ntuple_free(&net);
+
+   return 0;
+}
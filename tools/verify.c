@@ -0,0 +1,220 @@
+/* Replay verifier.
+ *
+ * Splits one or more replay streams into games and plays them back on
+ * every core. A game passes when every move changes the board and is
+ * followed by exactly the spawn the game's tile RNG draws, every undo
+ * goes back to a position played before and every recorded game over
+ * matches the board and score the rules engine arrived at. A game that loaded a
+ * save state cannot be checked and fails too. Writes one CSV line
+ * per game (file, index, score, moves, undos, restores, status) and a
+ * summary with the throughput on stderr; exits with 2 when any game
+ * failed.
+ *
+ *   2048_verify [-t threads] [-o file] replay...
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game_board.h"
+#include "game_replay.h"
+#include "game_pool.h"
+#include "tool_common.h"
+
+typedef struct
+{
+   const uint8_t *data;
+   size_t start;
+   size_t end;
+   int file;
+
+   replay_status_t status;
+   int64_t score;
+   unsigned moves;
+   unsigned undos;
+   unsigned restores;
+   unsigned ends;
+} verify_game_t;
+
+typedef struct
+{
+   const char *path;
+   uint8_t *data;
+   size_t size;
+} verify_file_t;
+
+static void verify_play(void *data)
+{
+   verify_game_t *game = (verify_game_t *)data;
+   replay_player_t player;
+
+   /* the header was checked when the file was split */
+   memset(&player, 0, sizeof(player));
+   player.data = game->data;
+   player.pos  = game->start;
+   player.size = game->end;
+
+   game->status = replay_play_game(&player);
+
+   /* a clean game must use up its whole slice */
+   if (game->status == REPLAY_OK && player.pos != game->end)
+      game->status = REPLAY_BAD_RECORD;
+
+   game->score    = player.score;
+   game->moves    = player.moves;
+   game->undos    = player.undos;
+   game->restores = player.restores;
+   game->ends     = player.ends;
+}
+
+/* Appends the games of one stream to *games, growing it as needed. */
+static bool split_file(const verify_file_t *file, int index,
+      verify_game_t **games, long *count, long *capacity)
+{
+   replay_player_t player;
+   replay_status_t status = replay_open(&player, file->data, file->size);
+
+   if (status != REPLAY_OK)
+   {
+      fprintf(stderr, "%s: %s\n", file->path, replay_status_string(status));
+      return false;
+   }
+
+   while (player.pos < player.size)
+   {
+      verify_game_t *game;
+      replay_record_t rec;
+      size_t start = player.pos;
+
+      /* step over the opening record so skipping stops at the next game */
+      if ((status = replay_read(&player, &rec)) == REPLAY_OK)
+         status = replay_skip_game(&player);
+
+      if (*count == *capacity)
+      {
+         long size            = *capacity ? *capacity * 2 : 1024;
+         verify_game_t *grown = (verify_game_t *)realloc(*games, size * sizeof(**games));
+
+         if (!grown)
+            return false;
+
+         *games    = grown;
+         *capacity = size;
+      }
+
+      game        = &(*games)[(*count)++];
+      game->data  = file->data;
+      game->start = start;
+      game->end   = status == REPLAY_OK ? player.pos : file->size;
+      game->file  = index;
+
+      /* nothing after a broken record can be lined up */
+      if (status != REPLAY_OK)
+         break;
+   }
+
+   return true;
+}
+
+int main(int argc, char **argv)
+{
+   int i, first, nfiles;
+   int threads         = (int)tool_arg_long(argc, argv, "-t", 0);
+   const char *path    = tool_arg(argc, argv, "-o");
+   FILE *out           = stdout;
+   verify_file_t *files;
+   verify_game_t *games = NULL;
+   long j, index = 0, count = 0, capacity = 0;
+   long failed = 0, unfinished = 0, restored = 0;
+   double total_moves = 0;
+   retro_time_t start, elapsed;
+
+   /* replay files follow the options */
+   for (first = 1; first < argc - 1 && argv[first][0] == '-'; first += 2);
+   nfiles = argc - first;
+
+   if (nfiles < 1)
+   {
+      fprintf(stderr, "usage: %s [-t threads] [-o file] replay...\n", argv[0]);
+      return 1;
+   }
+
+   if (!(files = (verify_file_t *)calloc(nfiles, sizeof(*files))))
+      return 1;
+
+   board_init_tables();
+
+   for (i = 0; i < nfiles; i++)
+   {
+      files[i].path = argv[first + i];
+
+      if (!(files[i].data = tool_read_file(files[i].path, &files[i].size)))
+      {
+         fprintf(stderr, "cannot read %s\n", files[i].path);
+         return 1;
+      }
+
+      if (!split_file(&files[i], i, &games, &count, &capacity))
+         return 1;
+   }
+
+   if (path && !(out = fopen(path, "w")))
+   {
+      fprintf(stderr, "cannot open %s\n", path);
+      return 1;
+   }
+
+   pool_init(threads);
+
+   start = tool_time_usec();
+   pool_run(verify_play, games, sizeof(*games), (int)count);
+   elapsed = tool_time_usec() - start;
+   if (elapsed < 1)
+      elapsed = 1;
+
+   fprintf(out, "file,game,score,moves,undos,restores,status\n");
+
+   for (j = 0, i = -1; j < count; j++)
+   {
+      verify_game_t *game    = &games[j];
+      replay_status_t status = game->status;
+
+      if (game->file != i)
+      {
+         i     = game->file;
+         index = 0;
+      }
+
+      fprintf(out, "%s,%ld,%lld,%u,%u,%u,%s\n", files[i].path, index++,
+            (long long)game->score, game->moves, game->undos, game->restores,
+            status == REPLAY_OK && !game->ends ? "unfinished"
+                                               : replay_status_string(status));
+
+      total_moves += game->moves;
+      if (status != REPLAY_OK)
+         failed++;
+      else if (!game->ends)
+         unfinished++;
+      if (game->restores)
+         restored++;
+   }
+
+   fprintf(stderr, "%ld games on %d threads in %.2fs: %.0f moves/s\n",
+         count, pool_threads(), elapsed / 1e6, total_moves * 1e6 / elapsed);
+   fprintf(stderr, "%ld failed, %ld unfinished, %ld with a save state load\n",
+         failed, unfinished, restored);
+
+   pool_deinit();
+
+   for (i = 0; i < nfiles; i++)
+      free(files[i].data);
+   free(files);
+   free(games);
+
+   if (out != stdout)
+      fclose(out);
+
+   return failed ? 2 : 0;
+}